@@ -2,12 +2,12 @@ CC = c99
 
 # Default flags.
 #
-# XOPEN_SOURCE=500 needed to use `sigaction`
-CFLAGS = -D_XOPEN_SOURCE=500 -O2 -pedantic -Wall -Werror -Wextra \
+# XOPEN_SOURCE=700 needed to use `sigaction`, `openat` and `O_NOFOLLOW`
+CFLAGS = -D_XOPEN_SOURCE=700 -O2 -pedantic -pthread -Wall -Werror -Wextra \
 	-Wno-implicit-fallthrough
 
 # OpenBSD flags. Uncomment to use
-# CFLAGS = -O2 -pedantic -Wall -Werror -Wextra
+# CFLAGS = -O2 -pedantic -pthread -Wall -Werror -Wextra
 
 NAME = se
 PREFIX = /usr/local
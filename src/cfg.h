@@ -15,8 +15,14 @@ enum {
  */
 enum {
 	CFG_DIRTY_FILE_QUIT_PRESSES_CNT = 4, /* Press to exit without saving. */
+	CFG_KEY_SEQ_TIMEOUT = 50, /* Milliseconds to wait the rest of sequence. */
+	CFG_SAVE_PROGRESS_PERIOD = 100, /* Milliseconds between saving redraws. */
+	CFG_SEARCH_THREADS_CNT = 1, /* Max count of threads to search in file. */
 	CFG_SPARE_PATH_MAX_LEN = 255, /* Max length of formatted spare save path. */
 	CFG_TAB_SIZE = 8, /* Count of spaces, which equals to one tab. */
+	CFG_UNDO_FILE_IS_ON = 0, /* Keep undo journal in spare dir between runs. */
+	CFG_UNDO_JOURNAL_SIZE = 1 << 20, /* Max bytes to remember changes. */
+	CFG_UNDO_SYNC_DELAY = 1000, /* Milliseconds without keys to sync journal. */
 };
 
 /*
@@ -45,10 +51,15 @@ enum {
 	CFG_KEY_MV_TO_END_OF_LINE = 'd',
 	CFG_KEY_MV_LEFT = 'h',
 	CFG_KEY_MV_TO_NEXT_WORD = 'e',
+	CFG_KEY_MV_TO_OFFSET = 'o', /* Number input is the byte offset. */
 	CFG_KEY_MV_TO_PREV_WORD = 'q',
 	CFG_KEY_MV_RIGHT = 'l',
 	CFG_KEY_MV_UP = 'k',
 
+	/* Undo and redo. */
+	CFG_KEY_REDO = 'r',
+	CFG_KEY_UNDO = 'u',
+
 	/* Save or quit. */
 	CFG_KEY_QUIT = 'q' - CTRL_OFFSET, /* CTRL-q. */
 	CFG_KEY_SAVE = 's' - CTRL_OFFSET, /* CTRL-s. */
@@ -21,12 +21,19 @@
  */
 struct ed {
 	struct vec *buf; /* Buffer for all drawn content. */
+	struct vec *slices; /* Rows drawn inside the buffer without copying. */
+	struct vec *stat; /* Drawn status. Used to skip drawing of the same. */
+	char is_drawn; /* Whether terminal has drawn content. 0 if unknown. */
+	char is_sync; /* Whether terminal reported synchronized output. */
 	struct win *win; /* Info about terminal's view. This is what the user sees. */
 	enum mode mode; /* Input mode. */
-	char msg[64]; /* Message for the user. */
+	char msg[CFG_SPARE_PATH_MAX_LEN + 64]; /* Message for the user. */
 	size_t num_input; /* Number input. 0 if not set. */
 	char search_input[64]; /* Search input. */
 	size_t search_input_len; /* Search query input length. */
+	char input[65536]; /* Readed keys input which is not processed yet. */
+	size_t input_len; /* Length of not processed input. */
+	char is_pasting; /* Whether input is pasted text now. */
 	unsigned char quit_presses_rem; /* Greater than 1 if file is dirty. */
 	volatile sig_atomic_t sigwinch; /* Resize flag. See signal-safety(7). */
 };
@@ -53,14 +60,16 @@ static int ed_del_char(struct ed *);
 static int ed_del_line(struct ed *);
 
 /*
- * Ends drawing area. For example, shows hidden cursor.
+ * Ends drawing area. For example, shows hidden cursor and ends synchronized
+ * output.
  *
  * Returns 0 on success and -1 on error.
  */
 static int ed_draw_end(struct ed *);
 
 /*
- * Starts drawing area. For example, hides the cursor and clears the screen.
+ * Starts drawing area. For example, begins synchronized output, hides the
+ * cursor and clears the screen if drawn content is unknown.
  *
  * Returns 0 on success and -1 on error.
  */
@@ -175,6 +184,23 @@ static void ed_num_input_clr(struct ed *);
  */
 static int ed_on_quit_press(struct ed *);
 
+/*
+ * Use it when saving of opened file failed with passed error number. Saves the
+ * file to spare dir and writes message about both savings.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int ed_on_save_err(struct ed *, int);
+
+/*
+ * Processes pasted text. Text is inserted to the file as is or appended to
+ * the search input in search mode. Invalid characters are removed from the
+ * passed text.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int ed_paste(struct ed *, char *, size_t);
+
 /*
  * Processes arrow key.
  *
@@ -189,6 +215,13 @@ static int ed_proc_arrow_key(struct ed *, const char *, size_t);
  */
 static int ed_proc_ins_key(struct ed *, char);
 
+/*
+ * Processes key which is a single character or a sequence.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int ed_proc_key(struct ed *, const char *, size_t);
+
 /*
  * Processes mouse wheel key.
  *
@@ -203,6 +236,14 @@ static int ed_proc_mouse_wh_key(struct ed *, const char *, size_t);
  */
 static int ed_proc_norm_key(struct ed *, char);
 
+/*
+ * Checks saving of opened file in background. Writes progress or result of
+ * the saving to the message.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int ed_proc_save(struct ed *);
+
 /*
  * Process key in search mode.
  *
@@ -230,7 +271,8 @@ static int ed_proc_sig(struct ed *);
 static size_t ed_repeat_times(const struct ed *);
 
 /*
- * Saves opened file.
+ * Starts saving of opened file in background. Saves to spare dir if saving
+ * can not be started.
  *
  * Writes message in the editor if save failed instead of returning -1.
  *
@@ -328,11 +370,16 @@ ed_draw(struct ed *const ed)
 	if (-1 == ret)
 		return -1;
 
+	/* Check saving in background. */
+	ret = ed_proc_save(ed);
+	if (-1 == ret)
+		return -1;
+
 	/* Draw all content. */
 	ret = ed_draw_start(ed);
 	if (-1 == ret)
 		return -1;
-	ret = win_draw_lines(ed->win, ed->buf);
+	ret = win_draw_lines(ed->win, ed->buf, ed->slices);
 	if (-1 == ret)
 		return -1;
 	ret = ed_draw_stat(ed);
@@ -357,7 +404,16 @@ ed_draw_end(struct ed *const ed)
 
 	/* Show hidden cursor. */
 	ret = esc_cur_show(ed->buf);
-	return ret;
+	if (-1 == ret)
+		return -1;
+
+	/* Show the whole frame at once. */
+	if (ed->is_sync) {
+		ret = esc_sync_end(ed->buf);
+		if (-1 == ret)
+			return -1;
+	}
+	return 0;
 }
 
 static int
@@ -365,19 +421,31 @@ ed_draw_start(struct ed *const ed)
 {
 	int ret;
 
-	/* Go to start of window and clear the window. */
-	ret = esc_go_home(ed->buf);
+	/* Let terminal to skip intermediate states of the frame. */
+	if (ed->is_sync) {
+		ret = esc_sync_begin(ed->buf);
+		if (-1 == ret)
+			return -1;
+	}
+
+	/* Hide cursor to not flicker. */
+	ret = esc_cur_hide(ed->buf);
 	if (-1 == ret)
 		return -1;
 
+	/* Do nothing if drawn content is known. */
+	if (ed->is_drawn)
+		return 0;
+
 	/* Clears all window for new content. */
-	ret = esc_clr_win(ed->buf);
+	ret = win_draw_clr(ed->win, ed->buf);
 	if (-1 == ret)
 		return -1;
-
-	/* Hide cursor to not flicker. */
-	ret = esc_cur_hide(ed->buf);
-	return ret;
+	ret = vec_set_len(ed->stat, 0);
+	if (-1 == ret)
+		return -1;
+	ed->is_drawn = 1;
+	return 0;
 }
 
 static int
@@ -387,7 +455,19 @@ ed_draw_stat(struct ed *const ed)
 	int left_len;
 	struct winsize winsize;
 	int right_len;
-	char right[128];
+	char right[160];
+	size_t start;
+	const char *stat;
+	size_t stat_len;
+	const char *drawn;
+	const size_t cur_start = vec_len(ed->buf);
+
+	/* Move to the status row. */
+	winsize = win_size(ed->win);
+	ret = esc_cur_set(ed->buf, winsize.ws_row - 1, 0);
+	if (-1 == ret)
+		return -1;
+	start = vec_len(ed->buf);
 
 	/* Begin status drawing. */
 	ret = ed_draw_stat_begin(ed);
@@ -398,6 +478,14 @@ ed_draw_stat(struct ed *const ed)
 	left_len = ed_draw_stat_left(ed);
 	if (-1 == left_len)
 		return -1;
+	/* Cut the left part if it does not fit the window. */
+	if (left_len > winsize.ws_col) {
+		ret = vec_set_len(
+			ed->buf, vec_len(ed->buf) - (left_len - winsize.ws_col));
+		if (-1 == ret)
+			return -1;
+		left_len = winsize.ws_col;
+	}
 	/* Format the right part to the passed buffer. */
 	right_len = ed_draw_stat_fmt_right(ed, right, sizeof(right));
 	if (-1 == right_len)
@@ -409,13 +497,29 @@ ed_draw_stat(struct ed *const ed)
 		return -1;
 
 	/* Draw the right part. */
-	winsize = win_size(ed->win);
 	ret = vec_append(ed->buf, right, MIN(right_len, winsize.ws_col - left_len));
 	if (-1 == ret)
 		return -1;
 
 	/* End status drawing. */
 	ret = ed_draw_stat_end(ed);
+	if (-1 == ret)
+		return -1;
+
+	/* Forget drawn status if the same is already drawn. */
+	stat = vec_get(ed->buf, start);
+	stat_len = vec_len(ed->buf) - start;
+	drawn = vec_items(ed->stat);
+	if (stat_len == vec_len(ed->stat) && 0 == memcmp(stat, drawn, stat_len)) {
+		ret = vec_set_len(ed->buf, cur_start);
+		return ret;
+	}
+
+	/* Remember drawn status. */
+	ret = vec_set_len(ed->stat, 0);
+	if (-1 == ret)
+		return -1;
+	ret = vec_append(ed->stat, stat, stat_len);
 	return ret;
 }
 
@@ -451,19 +555,23 @@ ed_draw_stat_fmt_right(
 	int ret;
 	size_t y;
 	size_t x;
+	size_t off;
 
 	/* Prepare length and formatted string for the right part. */
 	y = win_curr_line_idx(ed->win);
 	x = win_curr_line_char_idx(ed->win);
+	off = win_curr_offset(ed->win);
 	switch (ed->mode) {
 	case MODE_NORM:
-		ret = snprintf(buf, len, "%zu < %zu, %zu ", ed->num_input, y, x);
+		ret = snprintf(
+			buf, len, "%zu < %zu, %zu @ %zu ", ed->num_input, y, x, off);
 		break;
 	case MODE_SEARCH:
-		ret = snprintf(buf, len, "%s < %zu, %zu ", ed->search_input, y, x);
+		ret = snprintf(
+			buf, len, "%s < %zu, %zu @ %zu ", ed->search_input, y, x, off);
 		break;
 	default:
-		ret = snprintf(buf, len, "%zu, %zu ", y, x);
+		ret = snprintf(buf, len, "%zu, %zu @ %zu ", y, x, off);
 		break;
 	}
 
@@ -532,16 +640,24 @@ static int
 ed_flush_buf(struct ed *const ed)
 {
 	int ret;
-	ssize_t len;
 
-	/* Write buffer to terminal. */
-	len = term_write(vec_items(ed->buf), vec_len(ed->buf));
-	if (-1 == len)
+	/* Write buffer with drawn rows inside it to terminal. */
+	ret = term_write_slices(
+		vec_items(ed->buf),
+		vec_len(ed->buf),
+		vec_items(ed->slices),
+		vec_len(ed->slices)
+	);
+	if (-1 == ret)
 		return -1;
 
 	/*
-	 * Set the length to zero to continue appending characters to the beginning.
+	 * Set the lengths to zero to continue appending characters to the
+	 * beginning.
 	 */
+	ret = vec_set_len(ed->slices, 0);
+	if (-1 == ret)
+		return -1;
 	ret = vec_set_len(ed->buf, 0);
 	return ret;
 }
@@ -669,6 +785,32 @@ ed_on_quit_press(struct ed *const ed)
 	return ret;
 }
 
+static int
+ed_on_save_err(struct ed *const ed, const int err)
+{
+	int ret;
+	size_t len;
+	char path[CFG_SPARE_PATH_MAX_LEN + 1];
+
+	/* Try to keep changes in the spare dir. */
+	len = win_save_file_to_spare_dir(ed->win, path, sizeof(path));
+	if (0 == len) {
+		/* Write error message. */
+		ret = ed_msg_set(ed, "Failed to save: %s.", strerror(err));
+		return ret;
+	}
+	ed->quit_presses_rem = 1;
+
+	/* Write error message with the spare path. */
+	ret = ed_msg_set(
+		ed,
+		"Failed to save: %s. %zu bytes saved to %s.",
+		strerror(err),
+		len,
+		path);
+	return ret;
+}
+
 struct ed*
 ed_open(const char *const path, const int ifd, const int ofd)
 {
@@ -685,10 +827,20 @@ ed_open(const char *const path, const int ifd, const int ofd)
 	if (NULL == ed->buf)
 		goto err_free_opaque;
 
+	/* Allocate slices of drawn rows. */
+	ed->slices = vec_alloc(sizeof(struct term_slice), 64);
+	if (NULL == ed->slices)
+		goto err_free_opaque_and_buf;
+
+	/* Allocate buffer for drawn status. */
+	ed->stat = vec_alloc(sizeof(char), 256);
+	if (NULL == ed->stat)
+		goto err_free_opaque_buf_and_slices;
+
 	/* Open window with accepted file and descriptors. */
 	ed->win = win_open(path, ifd, ofd);
 	if (NULL == ed->win)
-		goto err_free_opaque_and_buf;
+		goto err_free_opaque_and_bufs;
 
 	/* Initialize other values */
 	ed_switch_mode(ed, MODE_NORM);
@@ -697,6 +849,10 @@ ed_open(const char *const path, const int ifd, const int ofd)
 	ed_search_input_clr(ed);
 	ed->quit_presses_rem = 1;
 	ed->sigwinch = 0;
+	ed->is_drawn = 0;
+	ed->is_sync = 0;
+	ed->input_len = 0;
+	ed->is_pasting = 0;
 
 	/* Enable alternate screen. It will be set during first drawing. */
 	ret = esc_alt_scr_on(ed->buf);
@@ -705,12 +861,29 @@ ed_open(const char *const path, const int ifd, const int ofd)
 
 	/* Enable mouse wheel tracking. It will be set during first drawing. */
 	ret = esc_mouse_wh_track_on(ed->buf);
+	if (-1 == ret)
+		goto err_clean_all;
+
+	/* Enable bracketed paste. It will be set during first drawing. */
+	ret = esc_paste_on(ed->buf);
+	if (-1 == ret)
+		goto err_clean_all;
+
+	/*
+	 * Ask for synchronized output. Frames are synchronized after the report
+	 * is readed as input, so terminals without answer are not waited.
+	 */
+	ret = esc_sync_query(ed->buf);
 	if (-1 == ret)
 		goto err_clean_all;
 	return ed;
 err_clean_all:
 	/* Error checking here is useless. */
 	win_close(ed->win);
+err_free_opaque_and_bufs:
+	vec_free(ed->stat);
+err_free_opaque_buf_and_slices:
+	vec_free(ed->slices);
 err_free_opaque_and_buf:
 	vec_free(ed->buf);
 err_free_opaque:
@@ -718,6 +891,43 @@ err_free_opaque:
 	return NULL;
 }
 
+static int
+ed_paste(struct ed *const ed, char *const text, const size_t len)
+{
+	int ret;
+	size_t i;
+	char ch;
+	size_t valid_len = 0;
+
+	/* Remove invalid characters. */
+	for (i = 0; i < len; i++) {
+		ch = text[i];
+		if (isprint(ch) || '\t' == ch || '\r' == ch || '\n' == ch)
+			text[valid_len++] = ch;
+	}
+	if (0 == valid_len)
+		return 0;
+
+	/* Pasted text is not a number input. */
+	ed_num_input_clr(ed);
+
+	/* Append printable characters to search input. */
+	if (MODE_SEARCH == ed->mode) {
+		for (i = 0; i < valid_len; i++)
+			if (isprint(text[i]))
+				ed_search_input(ed, text[i]);
+		return 0;
+	}
+
+	/* Insert text using window. */
+	ret = win_ins_text(ed->win, text, valid_len);
+	if (-1 == ret)
+		return -1;
+
+	ed->quit_presses_rem = CFG_DIRTY_FILE_QUIT_PRESSES_CNT;
+	return 0;
+}
+
 static int
 ed_proc_arrow_key(struct ed *const ed, const char *const seq, const size_t len)
 {
@@ -770,6 +980,46 @@ ed_proc_ins_key(struct ed *const ed, const char key)
 	return ret;
 }
 
+static int
+ed_proc_key(struct ed *const ed, const char *const seq, const size_t len)
+{
+	int ret = 0;
+
+	/* Remember support of synchronized output if it is reported. */
+	ret = esc_extr_sync_report(seq, len, &ed->is_sync);
+	if (0 == ret)
+		return 0;
+
+	/* Process key sequence if more than one characters readed. */
+	if (len > 1) {
+		/*
+		 * When switching to other modes, the number input will be cleared in the
+		 * normal mode key processing function. This is not done here, so we need
+		 * this line.
+		 */
+		ed_num_input_clr(ed);
+
+		ret = ed_proc_seq_key(ed, seq, len);
+		return ret;
+	}
+
+	/* Process single character keys in different input modes. */
+	switch (ed->mode) {
+	case MODE_NORM:
+		ret = ed_proc_norm_key(ed, seq[0]);
+		break;
+	case MODE_INS:
+		ret = ed_proc_ins_key(ed, seq[0]);
+		ed_num_input_clr(ed);
+		break;
+	case MODE_SEARCH:
+		ret = ed_proc_search_key(ed, seq[0]);
+		ed_num_input_clr(ed);
+		break;
+	}
+	return ret;
+}
+
 static int
 ed_proc_mouse_wh_key(
 	struct ed *const ed, const char *const seq, const size_t len)
@@ -852,6 +1102,9 @@ ed_proc_norm_key(struct ed *const ed, const char key)
 	case CFG_KEY_MV_TO_NEXT_WORD:
 		ret = win_mv_to_next_word(ed->win, ed_repeat_times(ed));
 		break;
+	case CFG_KEY_MV_TO_OFFSET:
+		ret = win_mv_to_offset(ed->win, ed->num_input);
+		break;
 	case CFG_KEY_MV_TO_PREV_WORD:
 		ret = win_mv_to_prev_word(ed->win, ed_repeat_times(ed));
 		break;
@@ -861,6 +1114,12 @@ ed_proc_norm_key(struct ed *const ed, const char key)
 	case CFG_KEY_SEARCH_FWD:
 		ret = win_search_fwd(ed->win, ed->search_input);
 		break;
+	case CFG_KEY_REDO:
+		ret = win_redo(ed->win, ed_repeat_times(ed));
+		break;
+	case CFG_KEY_UNDO:
+		ret = win_undo(ed->win, ed_repeat_times(ed));
+		break;
 	}
 
 	/* Check key processor error. */
@@ -878,6 +1137,43 @@ ed_proc_norm_key(struct ed *const ed, const char key)
 	return 0;
 }
 
+static int
+ed_proc_save(struct ed *const ed)
+{
+	int ret;
+	size_t len;
+	size_t written;
+	size_t percent;
+
+	/* Nothing to check if file is not being saved. */
+	if (!win_file_is_saving(ed->win))
+		return 0;
+
+	/* Check the saving. */
+	ret = win_save_file_bg_poll(ed->win, &written, &len);
+	if (-1 == ret) {
+		ret = ed_on_save_err(ed, errno);
+		return ret;
+	}
+
+	/* Show progress if there is no other message. Nothing to write is done. */
+	if (0 == ret) {
+		if (!ed_msg_is_empty(ed))
+			return 0;
+		percent = 0 == len ? 100 : written * 100 / len;
+		ret = ed_msg_set(ed, "Saving: %zu%%.", percent);
+		return ret;
+	}
+
+	/* Quit without confirmation if there are no changes after saving start. */
+	if (!win_file_is_dirty(ed->win))
+		ed->quit_presses_rem = 1;
+
+	/* Write success message. */
+	ret = ed_msg_set(ed, "%zu bytes saved.", len);
+	return ret;
+}
+
 static int
 ed_proc_search_key(struct ed *const ed, const char key)
 {
@@ -933,6 +1229,9 @@ ed_proc_sig(struct ed *const ed)
 		ret = win_upd_size(ed->win);
 		if (-1 == ret)
 			return ret;
+
+		/* Drawn content is unknown after resizing. */
+		ed->is_drawn = 0;
 	}
 	return 0;
 }
@@ -942,6 +1241,11 @@ ed_quit(struct ed *const ed)
 {
 	int ret;
 
+	/* Reset scrolling region set during drawing. */
+	ret = esc_scroll_region_reset(ed->buf);
+	if (-1 == ret)
+		return -1;
+
 	/* Disable alternate screen. */
 	ret = esc_alt_scr_off(ed->buf);
 	if (-1 == ret)
@@ -952,13 +1256,20 @@ ed_quit(struct ed *const ed)
 	if (-1 == ret)
 		return -1;
 
+	/* Disable bracketed paste. */
+	ret = esc_paste_off(ed->buf);
+	if (-1 == ret)
+		return -1;
+
 	/* Flush settings disabling. */
 	ret = ed_flush_buf(ed);
 	if (-1 == ret)
 		return -1;
 
-	/* Free content buffer. */
+	/* Free content and status buffers. */
 	vec_free(ed->buf);
+	vec_free(ed->slices);
+	vec_free(ed->stat);
 
 	/* Close the window. */
 	ret = win_close(ed->win);
@@ -991,21 +1302,20 @@ static int
 ed_save_file(struct ed *const ed)
 {
 	int ret;
-	size_t len;
 
-	/* Save file. */
-	len = win_save_file(ed->win);
-	if (0 == len) {
-		/* Write error message. */
-		ret = ed_msg_set(ed, "Failed to save: %s.", strerror(errno));
+	/* Only one saving at a time. */
+	if (win_file_is_saving(ed->win)) {
+		ret = ed_msg_set(ed, "Already saving.");
 		return ret;
 	}
 
-	ed->quit_presses_rem = 1;
-
-	/* Write success message. */
-	ret = ed_msg_set(ed, "%zu bytes saved.", len);
-	return ret;
+	/* Start saving. Progress and result are checked during drawing. */
+	ret = win_save_file_bg(ed->win);
+	if (-1 == ret) {
+		ret = ed_on_save_err(ed, errno);
+		return ret;
+	}
+	return 0;
 }
 
 static int
@@ -1015,6 +1325,12 @@ ed_save_file_to_spare_dir(struct ed *const ed)
 	char path[CFG_SPARE_PATH_MAX_LEN + 1];
 	size_t len;
 
+	/* Only one saving at a time. */
+	if (win_file_is_saving(ed->win)) {
+		ret = ed_msg_set(ed, "Already saving.");
+		return ret;
+	}
+
 	/* Save file to the spare dir. */
 	len = win_save_file_to_spare_dir(ed->win, path, sizeof(path));
 	if (0 == len) {
@@ -1076,43 +1392,90 @@ ed_switch_mode(struct ed *const ed, const enum mode mode)
 }
 
 int
-ed_wait_and_proc_key(struct ed *const ed)
+ed_wait_and_proc_keys(struct ed *const ed)
 {
-	int ret = 0;
-	char seq[4];
-	size_t seq_len;
-
-	/* Wait key press. */
-	seq_len = term_wait_key(seq, sizeof(seq));
-	if (0 == seq_len)
+	int ret;
+	ssize_t readed;
+	char is_full;
+	char is_late;
+	size_t key_len;
+	size_t text_len;
+	size_t end_len;
+	int timeout;
+	size_t i = 0;
+	/* Beginning of the sequence is kept if its rest is not readed yet. */
+	const char is_seq_kept = ed->input_len > 0 && !ed->is_pasting;
+
+	/* Wake up periodically to show progress of the saving. */
+	timeout = win_file_is_saving(ed->win) ? CFG_SAVE_PROGRESS_PERIOD : -1;
+	/* Wake up to sync journal of changes if keys are not pressed. */
+	if (-1 == timeout && !win_file_is_undo_synced(ed->win))
+		timeout = CFG_UNDO_SYNC_DELAY;
+	/* Wait the rest of the sequence shortly to tell it from escape key. */
+	if (is_seq_kept)
+		timeout = CFG_KEY_SEQ_TIMEOUT;
+
+	/* Wait key presses and read all available input after not processed. */
+	readed = term_wait_keys(
+		&ed->input[ed->input_len], sizeof(ed->input) - ed->input_len, timeout);
+	if (-1 == readed)
 		return -1;
+	/* Sync journal of changes while the user is idle. */
+	if (0 == readed && !is_seq_kept)
+		win_file_sync_undo(ed->win);
+	ed->input_len += readed;
+	/* Input may be cut in the middle of the sequence if buffer is full. */
+	is_full = sizeof(ed->input) == ed->input_len;
+	/* The rest of the kept sequence does not come. */
+	is_late = is_seq_kept && 0 == readed;
+
+	while (i < ed->input_len && !ed_need_to_quit(ed)) {
+		if (ed->is_pasting) {
+			/* Process pasted text up to the end of paste. */
+			text_len = esc_paste_len(&ed->input[i], ed->input_len - i, &end_len);
+			ret = ed_paste(ed, &ed->input[i], text_len);
+			if (-1 == ret)
+				return -1;
+			i += text_len;
+
+			/* Wait the rest of pasted text if the end is not readed yet. */
+			if (0 == end_len)
+				break;
+			i += end_len;
+			ed->is_pasting = 0;
+			continue;
+		}
 
-	/* Process key sequence if more than one characters readed. */
-	if (seq_len > 1) {
-		/*
-		 * When switching to other modes, the number input will be cleared in the
-		 * normal mode key processing function. This is not done here, so we need
-		 * this line.
-		 */
-		ed_num_input_clr(ed);
+		/* Get length of the next key. */
+		key_len = esc_key_len(&ed->input[i], ed->input_len - i);
+		if (0 == key_len) {
+			/* Wait the rest of the sequence if it is not readed yet. */
+			if ((is_full && i > 0) || (!is_full && !is_late))
+				break;
+			/* Otherwise process only the escape as a single key. */
+			key_len = 1;
+		}
 
-		ret = ed_proc_seq_key(ed, seq, seq_len);
-		return ret;
+		/* Begin pasting if the key is the beginning of paste. */
+		if (esc_is_paste_start(&ed->input[i], key_len)) {
+			ed->is_pasting = 1;
+			i += key_len;
+			continue;
+		}
+
+		/* Process the key. */
+		ret = ed_proc_key(ed, &ed->input[i], key_len);
+		if (-1 == ret)
+			return -1;
+		i += key_len;
 	}
 
-	/* Process single character keys in different input modes. */
-	switch (ed->mode) {
-	case MODE_NORM:
-		ret = ed_proc_norm_key(ed, seq[0]);
-		break;
-	case MODE_INS:
-		ret = ed_proc_ins_key(ed, seq[0]);
-		ed_num_input_clr(ed);
-		break;
-	case MODE_SEARCH:
-		ret = ed_proc_search_key(ed, seq[0]);
-		ed_num_input_clr(ed);
-		break;
+	/* Keep not processed input until next waiting. */
+	if (i < ed->input_len && !ed_need_to_quit(ed)) {
+		memmove(ed->input, &ed->input[i], ed->input_len - i);
+		ed->input_len -= i;
+	} else {
+		ed->input_len = 0;
 	}
-	return ret;
+	return 0;
 }
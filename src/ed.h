@@ -40,10 +40,11 @@ int ed_quit(struct ed *);
 void ed_reg_sig(struct ed *, int);
 
 /*
- * Waits key press and processes it.
+ * Waits key presses and processes all available keys. So the editor can be
+ * drawn once after several keys, for example, after pasting.
  *
  * Returns 0 on success and -1 on error.
  */
-int ed_wait_and_proc_key(struct ed *);
+int ed_wait_and_proc_keys(struct ed *);
 
 #endif /* _ED_H */
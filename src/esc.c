@@ -1,9 +1,19 @@
-#include <stdio.h>
 #include <string.h>
 #include "color.h"
 #include "esc.h"
 #include "vec.h"
 
+/*
+ * Appends control sequence with passed prefix of parameters, numeric
+ * parameters separated by semicolons and final character. Numbers are
+ * formatted without `printf`, because sequences are appended many times
+ * during every drawing.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int esc_append_csi(
+	struct vec *, const char *, const unsigned *, size_t, char);
+
 int
 esc_alt_scr_on(struct vec *const buf)
 {
@@ -22,6 +32,55 @@ esc_alt_scr_off(struct vec *const buf)
 	return ret;
 }
 
+static int
+esc_append_csi(
+	struct vec *const buf,
+	const char *const prefix,
+	const unsigned *const nums,
+	const size_t cnt,
+	const char final)
+{
+	int ret;
+	size_t i;
+	size_t len;
+	unsigned rest;
+	char *digit;
+	char seq[64];
+	char *end = seq;
+
+	/* Begin with introducer and prefix of parameters. */
+	*end++ = '\x1b';
+	*end++ = '[';
+	len = strlen(prefix);
+	memcpy(end, prefix, len);
+	end += len;
+
+	for (i = 0; i < cnt; i++) {
+		if (i > 0)
+			*end++ = ';';
+
+		/* Count digits to write them from the last one. */
+		for (rest = nums[i] / 10, len = 1; rest > 0; rest /= 10)
+			len++;
+		end += len;
+		for (rest = nums[i], digit = end; digit > end - len; rest /= 10)
+			*--digit = '0' + rest % 10;
+	}
+	*end++ = final;
+
+	ret = vec_append(buf, seq, end - seq);
+	return ret;
+}
+
+int
+esc_clr_line_end(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[K", 3);
+	return ret;
+}
+
 int
 esc_clr_win(struct vec *const buf)
 {
@@ -35,18 +94,20 @@ int
 esc_color_bg(struct vec *const buf, const struct color c)
 {
 	int ret;
+	const unsigned nums[] = {c.r, c.g, c.b};
 
-	ret = vec_append_fmt(buf, "\x1b[48;2;%hhu;%hhu;%hhum", c.r, c.g, c.b);
-	return -1 == ret ? -1 : 0;
+	ret = esc_append_csi(buf, "48;2;", nums, 3, 'm');
+	return ret;
 }
 
 int
 esc_color_fg(struct vec *const buf, const struct color c)
 {
 	int ret;
+	const unsigned nums[] = {c.r, c.g, c.b};
 
-	ret = vec_append_fmt(buf, "\x1b[38;2;%hhu;%hhu;%hhum", c.r, c.g, c.b);
-	return -1 == ret ? -1 : 0;
+	ret = esc_append_csi(buf, "38;2;", nums, 3, 'm');
+	return ret;
 }
 
 int
@@ -72,9 +133,10 @@ esc_cur_set(
 	struct vec *const buf, const unsigned short row, const unsigned short col)
 {
 	int ret;
+	const unsigned nums[] = {row + 1, col + 1};
 
-	ret = vec_append_fmt(buf, "\x1b[%hu;%huH", row + 1, col + 1);
-	return -1 == ret ? -1 : 0;
+	ret = esc_append_csi(buf, "", nums, 2, 'H');
+	return ret;
 }
 
 int
@@ -112,7 +174,7 @@ esc_extr_mouse_wh_key(
 	int cmp;
 
 	/* Validate length. */
-	if (4 != len)
+	if (6 != len)
 		return -1;
 
 	cmp = strncmp("\x1b[M", seq, 3);
@@ -124,6 +186,21 @@ esc_extr_mouse_wh_key(
 	return -1;
 }
 
+int
+esc_extr_sync_report(
+	const char *const seq, const size_t len, char *const is_supported)
+{
+	/* Validate length and the report of the mode. */
+	if (11 != len || 0 != memcmp("\x1b[?2026;", seq, 8))
+		return -1;
+	if (0 != memcmp("$y", &seq[9], 2))
+		return -1;
+
+	/* Mode is set, reset or permanently set. */
+	*is_supported = '1' <= seq[8] && seq[8] <= '3';
+	return 0;
+}
+
 int
 esc_go_home(struct vec *const buf)
 {
@@ -133,6 +210,43 @@ esc_go_home(struct vec *const buf)
 	return ret;
 }
 
+char
+esc_is_paste_start(const char *const seq, const size_t len)
+{
+	return 6 == len && 0 == memcmp("\x1b[200~", seq, 6);
+}
+
+size_t
+esc_key_len(const char *const seq, const size_t len)
+{
+	size_t i;
+
+	/* Check single character keys. */
+	if (seq[0] != '\x1b')
+		return 1;
+	if (len < 2)
+		return 0;
+
+	switch (seq[1]) {
+	case 'O':
+		/* Function key with one final character. */
+		return len < 3 ? 0 : 3;
+	case '[':
+		/* Mouse event with button and pointer's coordinates. */
+		if (len > 2 && 'M' == seq[2])
+			return len < 6 ? 0 : 6;
+
+		/* Skip parameters and intermediate characters up to final one. */
+		for (i = 2; i < len; i++)
+			if ('@' <= seq[i] && seq[i] <= '~')
+				return i + 1;
+		return 0;
+	default:
+		/* Escape key itself. */
+		return 1;
+	}
+}
+
 int
 esc_mouse_wh_track_off(struct vec *const buf)
 {
@@ -150,3 +264,122 @@ esc_mouse_wh_track_on(struct vec *const buf)
 	ret = vec_append(buf, "\x1b[?1000h", 8);
 	return ret;
 }
+
+int
+esc_paste_off(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[?2004l", 8);
+	return ret;
+}
+
+int
+esc_paste_on(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[?2004h", 8);
+	return ret;
+}
+
+size_t
+esc_paste_len(const char *const input, const size_t len, size_t *const end_len)
+{
+	const char *esc;
+	size_t rem;
+	const char *ptr = input;
+	const char *const end = input + len;
+
+	*end_len = 0;
+	while (ptr < end) {
+		/* Find the next escape character. */
+		esc = memchr(ptr, '\x1b', end - ptr);
+		if (NULL == esc)
+			break;
+
+		/* Check the end of paste. */
+		rem = end - esc;
+		if (rem >= 6 && 0 == memcmp("\x1b[201~", esc, 6)) {
+			*end_len = 6;
+			return esc - input;
+		}
+
+		/* Do not count the beginning of the end of paste. */
+		if (rem < 6 && 0 == memcmp("\x1b[201~", esc, rem))
+			return esc - input;
+		ptr = esc + 1;
+	}
+
+	/* Do not count carriage return which may be followed by line feed. */
+	if (len > 0 && '\r' == input[len - 1])
+		return len - 1;
+	return len;
+}
+
+int
+esc_scroll_down(struct vec *const buf, const unsigned short cnt)
+{
+	int ret;
+	const unsigned nums[] = {cnt};
+
+	ret = esc_append_csi(buf, "", nums, 1, 'T');
+	return ret;
+}
+
+int
+esc_scroll_region_reset(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[r", 3);
+	return ret;
+}
+
+int
+esc_scroll_region_set(
+	struct vec *const buf, const unsigned short top, const unsigned short bot)
+{
+	int ret;
+	const unsigned nums[] = {top + 1, bot + 1};
+
+	ret = esc_append_csi(buf, "", nums, 2, 'r');
+	return ret;
+}
+
+int
+esc_scroll_up(struct vec *const buf, const unsigned short cnt)
+{
+	int ret;
+	const unsigned nums[] = {cnt};
+
+	ret = esc_append_csi(buf, "", nums, 1, 'S');
+	return ret;
+}
+
+int
+esc_sync_begin(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[?2026h", 8);
+	return ret;
+}
+
+int
+esc_sync_end(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[?2026l", 8);
+	return ret;
+}
+
+int
+esc_sync_query(struct vec *const buf)
+{
+	int ret;
+
+	ret = vec_append(buf, "\x1b[?2026$p", 9);
+	return ret;
+}
@@ -31,6 +31,13 @@ int esc_alt_scr_off(struct vec *);
  * */
 int esc_alt_scr_on(struct vec *);
 
+/*
+ * Clears the row from the cursor to the end of the row.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_clr_line_end(struct vec *);
+
 /*
  * Clears all window.
  *
@@ -90,7 +97,7 @@ int esc_cur_show(struct vec *);
 int esc_extr_arrow_key(const char *, size_t, enum arrow_key *);
 
 /*
- * Extracts mouse wheel key from sequence.
+ * Extracts mouse wheel key from sequence. Pointer's coordinates are ignored.
  *
  * Returns 0 on success and -1 on error.
  *
@@ -98,6 +105,16 @@ int esc_extr_arrow_key(const char *, size_t, enum arrow_key *);
  */
 int esc_extr_mouse_wh_key(const char *, size_t, enum mouse_wh_key *);
 
+/*
+ * Extracts support of synchronized output from the terminal's report which
+ * answers `esc_sync_query`. Output is supported if the mode can be set.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets no errors.
+ */
+int esc_extr_sync_report(const char *, size_t, char *);
+
 /*
  * Moves the current writing pointer to the beginning of the window.
  *
@@ -105,6 +122,20 @@ int esc_extr_mouse_wh_key(const char *, size_t, enum mouse_wh_key *);
  */
 int esc_go_home(struct vec *);
 
+/*
+ * Checks that the sequence is the beginning of pasted text.
+ */
+char esc_is_paste_start(const char *, size_t);
+
+/*
+ * Calculates length of the first key in the input. Key is a single character
+ * or an escape sequence. Mouse wheel sequences are longer than others because
+ * of pointer's coordinates.
+ *
+ * Returns length of the key or 0 if input ends before the end of sequence.
+ */
+size_t esc_key_len(const char *, size_t);
+
 /*
  * Disables mouse wheel tracking.
  *
@@ -119,4 +150,84 @@ int esc_mouse_wh_track_off(struct vec *);
  */
 int esc_mouse_wh_track_on(struct vec *);
 
+/*
+ * Disables bracketed paste mode.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_paste_off(struct vec *);
+
+/*
+ * Enables bracketed paste mode, so pasted text is surrounded by special
+ * sequences. Do not forget to disable it.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_paste_on(struct vec *);
+
+/*
+ * Calculates length of pasted text in the input up to the end of paste. If
+ * the end of paste is found, its length is written to the passed pointer.
+ * Otherwise, 0 is written and the input's tail which may be the beginning of
+ * the end of paste or the carriage return before line feed is not counted.
+ *
+ * Returns length of pasted text.
+ */
+size_t esc_paste_len(const char *, size_t, size_t *);
+
+/*
+ * Scrolls content of scrolling region down by passed rows count. New rows
+ * appear empty at the top.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_scroll_down(struct vec *, unsigned short);
+
+/*
+ * Resets scrolling region to the whole window.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_scroll_region_reset(struct vec *);
+
+/*
+ * Sets scrolling region using first and last rows. Values start from zero.
+ * Also moves the cursor to the beginning of the window. Do not forget to
+ * reset it.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_scroll_region_set(struct vec *, unsigned short, unsigned short);
+
+/*
+ * Scrolls content of scrolling region up by passed rows count. New rows
+ * appear empty at the bottom.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_scroll_up(struct vec *, unsigned short);
+
+/*
+ * Begins synchronized output. Terminal shows the output up to its end at
+ * once, so intermediate states are not drawn. Do not forget to end it.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_sync_begin(struct vec *);
+
+/*
+ * Ends synchronized output and shows the output since its beginning.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_sync_end(struct vec *);
+
+/*
+ * Requests the state of synchronized output mode. Terminal which supports it
+ * reports the state as input.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int esc_sync_query(struct vec *);
+
 #endif /* _ESC_H */
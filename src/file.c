@@ -1,27 +1,95 @@
 #include <errno.h>
+#include <fcntl.h>
 #include <libgen.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 #include "cfg.h"
 #include "dt.h"
 #include "file.h"
 #include "math.h"
+#include "search.h"
+#include "slab.h"
 #include "str.h"
+#include "tree.h"
+#include "undo.h"
 #include "vec.h"
 
 enum {
-	LINE_CHARS_CAP_STEP = 128, /* Line's chars capacity reallocation step. */
-	FILE_LINES_CAP_STEP = 32, /* File's lines capacity reallocation step. */
+	LINE_EXPS_STEP = 64, /* Chars between remembered expanded columns. */
+	LINE_INLINE_CAP = 24, /* Max length of content stored in the line itself. */
+	LINE_SHRINK_MIN_CAP = 64, /* Max capacity of line which is not shrunk. */
+	LINE_SHRINK_RATIO = 4, /* Shrink line if its capacity is unused in times. */
+	FILE_GAP_MIN_LEN = 1 << 12, /* Min length of line to edit it with gap. */
+	FILE_INDEX_LINES_CNT = 256, /* Max lines to append at once on opening. */
+	FILE_ORIG_CAP_STEP = 4096, /* Original buffer capacity if size unknown. */
+	FILE_READ_BLOCK_SIZE = 1 << 20, /* Max size of one read system call. */
+	FILE_SAVE_TAIL_MAX_LEN = 1 << 24, /* Max changed tail to write in place. */
+	FILE_SAVE_TAIL_MIN_OFF = 1 << 26, /* Min unchanged prefix to keep. */
+	FILE_SEARCH_CHUNK_SIZE = 1 << 20, /* Min size of text to search at once. */
+	FILE_SAVING_IOVS_MIN_CAP = 64, /* Min capacity of saved content buffers. */
+	FILE_SEARCH_PART_MIN_LINES = 1 << 16, /* Min lines to search in thread. */
+	FILE_WRITE_BLOCK_SIZE = 1 << 20, /* Max size of one write system call. */
+	FILE_WRITE_IOVS_CNT = 1024, /* Max buffers of one write system call. */
 };
 
+/*
+ * Vector of characters to scan many characters at once. Bits of comparison
+ * masks correspond to characters in the vector.
+ */
+#if defined(__AVX2__)
+typedef __m256i scan_vec;
+#define SCAN_VEC_SET1(ch) _mm256_set1_epi8(ch)
+#define SCAN_VEC_LOAD(ptr) _mm256_loadu_si256((const __m256i *)(ptr))
+#define SCAN_VEC_EQ_MASK(x, y) \
+	((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8((x), (y))))
+#elif defined(__SSE2__)
+typedef __m128i scan_vec;
+#define SCAN_VEC_SET1(ch) _mm_set1_epi8(ch)
+#define SCAN_VEC_LOAD(ptr) _mm_loadu_si128((const __m128i *)(ptr))
+#define SCAN_VEC_EQ_MASK(x, y) \
+	((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8((x), (y))))
+#endif
+
 /*
  * Line of the opened file.
+ *
+ * Until the first modification the line is a piece of the file's original
+ * buffer. The first modification moves the content to the line's own buffer.
  */
 struct line {
-	struct vec *chars; /* Raw content. Does not contain '\n' or '\0'. */
-	char *render; /* Rendered version of the content. */
-	size_t render_len; /* Length of rendered content. */
+	union {
+		char *ptr; /* Piece of original buffer or own chunk of the slab. */
+		char buf[LINE_INLINE_CAP]; /* Own short content. */
+	} chars;
+	size_t len; /* Length of the content. Does not contain '\n'. */
+	size_t cap; /* Capacity of own content or 0 if line is a piece. */
+	struct render *render; /* Render or `NULL` if it is outdated or not needed. */
+};
+
+/*
+ * Rendered version of the line's content how it looks in the window. Stored
+ * in a chunk of the slab.
+ */
+struct render {
+	size_t len; /* Length of rendered content. */
+	size_t cap; /* Capacity of rendered content. */
+	size_t from; /* First char with outdated render or `SIZE_MAX`. */
+	size_t *exps; /* Expanded columns of every `LINE_EXPS_STEP` chars. */
+	size_t exps_cap; /* Capacity of expanded columns. */
+	char chars[]; /* Rendered content. */
 };
 
 /*
@@ -30,9 +98,94 @@ struct line {
 struct file {
 	char *path; /* Path of readed file. This is where the default save occurs. */
 	char is_dirty; /* If set, then the file has unsaved changes. */
-	struct vec *lines; /* lines of file. There is always at least one line. */
+	char *orig; /* Original content of the file. Never modified. */
+	size_t orig_len; /* Length of original content. */
+	char is_mapped; /* If set, then original content is mapped file. */
+	char is_mapped_saved; /* If set, then saves write to the mapped file. */
+	struct undo_stamp saved_stamp; /* State of the file after the last save. */
+	size_t changed_idx; /* First line changed after last save or `SIZE_MAX`. */
+	struct tree *lines; /* lines of file. There is always at least one line. */
+	struct slab *slab; /* Allocator of own contents and renders of lines. */
+	size_t gap_idx; /* Line with unused capacity inside or `SIZE_MAX`. */
+	size_t gap_pos; /* Position of unused capacity inside the line. */
+	char is_gap_plain; /* If set, then the line with gap has no tabs. */
+	struct undo *undo; /* Journal of changes to undo and redo them. */
+	char is_journaled; /* If set, then changes are written to the journal. */
+	struct file_saving *saving; /* Saving in other thread or `NULL`. */
+	struct file_searchers *searchers; /* Threads to search or `NULL`. */
+};
+
+/*
+ * Saving of the file. Content is gathered at start, so the saving does not
+ * depend on further changes and may be done in other thread.
+ */
+struct file_saving {
+	char *path; /* Path to save to. */
+	char is_custom; /* If set, then path is not the path of opened file. */
+	char was_dirty; /* If set, then the file was dirty before the saving. */
+	size_t changed_idx; /* First changed line of the file before the saving. */
+	char is_tail; /* If set, then only the tail after offset is written. */
+	size_t off; /* Offset of content in the file. */
+	struct iovec *iovs; /* Content of the file. Pieces are not copied. */
+	size_t iovs_cnt; /* Count of content buffers. */
+	size_t iovs_cap; /* Capacity of content buffers. */
+	char *own; /* Copy of own lines with line breaks. */
+	size_t own_len; /* Length of the copy. */
+	size_t own_cap; /* Capacity of the copy. */
+	size_t len; /* Length of content. */
+	pthread_t thread; /* Thread which saves the content. */
+	char is_threaded; /* If set, then the thread is started. */
+	pthread_mutex_t mutex; /* Protects the fields below. */
+	size_t written; /* Written bytes count. */
+	char is_done; /* If set, then the saving is finished. */
+	int err; /* Error number of the failed saving or 0. */
+};
+
+/* State which is shared between parts of the search. */
+struct file_search_found {
+	pthread_mutex_t mutex; /* Protects the number of found part. */
+	size_t num; /* Number of the closest part with result or `SIZE_MAX`. */
+};
+
+/* Range of lines which is searched in a separate thread. */
+struct file_search_part {
+	const struct file *file; /* Searched file. */
+	const struct search *search; /* Compiled query. */
+	char is_fwd; /* If set, then search is forward. */
+	size_t first; /* First line of the part. */
+	size_t last; /* Last line of the part. */
+	size_t idx; /* Line to start from. Line of result after search. */
+	size_t pos; /* Position to start from. Position of result after search. */
+	size_t num; /* Number of the part. Closer to start parts have less ones. */
+	int ret; /* Result of the search in the part. */
+	struct file_search_found *found; /* State shared between parts. */
 };
 
+/*
+ * Threads which search in far parts of lines. Threads are started at the first
+ * search of many lines and wait parts of next searches until the file is freed.
+ */
+struct file_searchers {
+	pthread_t threads[CFG_SEARCH_THREADS_CNT]; /* Started threads. */
+	size_t threads_cnt; /* Count of started threads. */
+	pthread_mutex_t mutex; /* Protects the fields below. */
+	pthread_cond_t work_cond; /* Signals parts to search and stopping. */
+	pthread_cond_t done_cond; /* Signals that all parts are searched. */
+	struct file_search_part *parts; /* Parts of the current search. */
+	size_t parts_cnt; /* Count of parts of the current search. */
+	size_t next; /* Next part which is not taken by any thread. */
+	size_t done_cnt; /* Count of searched parts. */
+	char is_stopped; /* If set, then threads must exit. */
+};
+
+/*
+ * Appends indexed lines to the end of the file's lines and resets passed count
+ * of them.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_add_lines(struct file *, const struct line *, size_t *);
+
 /*
  * Allocates empty file container. Do not forget to free it.
  *
@@ -40,928 +193,3751 @@ struct file {
  */
 static struct file *file_alloc(const char *);
 
+/*
+ * Attaches file from private dir in spare dir to keep undo journal between
+ * runs. The file is optional, so errors are ignored. Symbolic links, hard
+ * links and files of other users are not used, so the journal can not be
+ * redirected to other file.
+ */
+static void file_attach_undo(struct file *, const struct stat *);
+
 /*
  * Frees file allocated file.
  */
 static void file_free(struct file *);
 
 /*
- * Reads lines from the file.
+ * Moves unused capacity of the line with gap to its end, so the line is
+ * contiguous again, and forgets the gap. Does nothing if there is no gap.
+ */
+static void file_gap_close(struct file *);
+
+/*
+ * Moves unused capacity of the line with gap to passed position. Only
+ * characters between old and new positions are moved.
+ */
+static void file_gap_move(struct file *, size_t);
+
+/*
+ * Moves unused capacity of the long line to passed position to insert and
+ * delete characters there without moving the rest of the line. Closes gap of
+ * other line. Grows the line if there is no unused capacity.
  *
- * Returns 0 on success and -1 on error. Note that you need to free readed
- * lines.
+ * Returns 1 if gap is at the position, 0 if the line is short to have gap and
+ * -1 on error.
  */
-static int file_read(struct file *, FILE *);
+static int file_gap_open(struct file *, size_t, size_t);
 
 /*
- * Writes lines to the file.
+ * Deletes text which is inserted at passed line and position. Text's line
+ * breaks are the same as in `file_ins_text`.
  *
- * Returns written bytes count on success and 0 on error.
+ * Returns 0 on success and -1 on error.
  */
-static size_t file_write(const struct file *, FILE *);
+static int file_del_text(struct file *, size_t, size_t, const char *, size_t);
 
 /*
- * Appends passed chars to line and renders updated line.
+ * Splits original buffer into lines. Lines are pieces of the buffer, so no
+ * characters are copied. Line breaks are found using vector instructions if
+ * available.
  *
  * Returns 0 on success and -1 on error.
  */
-static int line_append(struct line *, const char *, size_t);
+static int file_index_lines(struct file *);
 
 /*
- * Breaks the line at passed index. Writes broken right part to the passed
- * line.
+ * Writes change to the journal if file is journaled.
  *
- * Returns 0 on success an -1 on error.
+ * Returns 0 on success and -1 on error.
  */
-int line_break(struct line *, size_t, struct line *);
+static int file_journal(
+	struct file *, enum undo_op, size_t, size_t, const char *, size_t);
 
 /*
- * Calculates render's capacity using characters. Useful after characters
- * update.
+ * Inits line as a piece of original buffer.
  */
-static size_t line_calc_render_cap(struct line *);
+static void file_init_piece(struct line *, char *, const char *);
 
 /*
- * Cuts a line, shrinks its capacity and rerenders it. The argument specifies
- * how many first characters will remain.
+ * Maps the file to memory and uses mapping as original content.
  *
- * Returns 0 on success and -1 on error.
+ * Returns 1 if the file mapped, 0 if the file can not be mapped, for example,
+ * if it is empty or not regular, and -1 on error.
  */
-static int line_cut(struct line *, size_t);
+static int file_map_orig(struct file *, int);
 
 /*
- * Deletes character from line at passed index and after rerenders the line.
- *
- * Returns 0 on success and -1 on error.
+ * Marks the file as dirty with changes from passed line.
+ */
+static void file_mark_dirty(struct file *, size_t);
+
+/*
+ * Returns index of the first line of the run which ends with passed line.
+ * Lines of the run are pieces which follow each other in the original buffer
+ * with single '\n' between them. Run's size is limited by search chunk size.
+ * Lines are got using passed hint, so neighbour runs are found fast.
+ */
+static size_t file_piece_run_begin(
+	const struct file *, size_t, struct tree_hint *);
+
+/*
+ * Returns index of the last line of the run which begins with passed line.
+ */
+static size_t file_piece_run_end(
+	const struct file *, size_t, struct tree_hint *);
+
+/*
+ * Returns index of the run's line which contains passed character.
  */
-int line_del_char(struct line *, size_t);
+static size_t file_piece_run_line(
+	const struct file *, size_t, size_t, const char *);
 
 /*
- * Frees allocated line's buffer.
+ * Reads lines from the file. Maps the file to memory if possible or reads it
+ * otherwise.
+ *
+ * Returns 0 on success and -1 on error. Note that you need to free readed
+ * lines.
  */
-static void line_free(struct line *);
+static int file_read(struct file *, int);
 
 /*
- * Initializes line with zeros. Do not forget to free it.
+ * Reads all content of the file to the original buffer using big blocks.
  *
  * Returns 0 on success and -1 on error.
  */
-static int line_init(struct line *);
+static int file_read_orig(struct file *, int);
 
 /*
- * Inserts character to line at passed index and after rerenders the line.
+ * Applies journaled change again.
  *
  * Returns 0 on success and -1 on error.
  */
-int line_ins_char(struct line *, size_t, char);
+static int file_redo_rec(struct file *, const struct undo_rec *);
 
 /*
- * Reads line characters from a file without `'\n'`.
+ * Reverts journaled change.
  *
- * Returns 1 if line readed, 0 if EOF reached and there is no line to read and
- * -1 if error.
+ * Returns 0 on success and -1 on error.
  */
-static int line_read(struct line *, FILE *);
+static int file_revert_rec(struct file *, const struct undo_rec *);
 
 /*
- * Allocates big enough buffer and renders characters to it how it look in the
- * window.
+ * Writes content to a temporary file in the directory of passed path, flushes
+ * it to the disk and renames it over passed path. The file on passed path is
+ * either replaced entirely or is not changed. Mode and ownership are copied
+ * from passed info of the replaced file if it is not `NULL`.
  *
  * Returns 0 on success and -1 on error.
  */
-static int line_render(struct line *);
+static int file_save_atomic(
+	struct file_saving *, const char *, const struct stat *);
 
 /*
- * Renders line characters in existing buffer how it look in the window. Make
- * sure that render buffer capacity is big enough.
+ * Truncates the file on passed path and writes content to it. Used for files
+ * which can not be replaced like devices and pipes.
+ *
+ * Returns 0 on success and -1 on error.
  */
-static void line_render_no_alloc(struct line *);
+static int file_save_in_place(struct file_saving *, const char *);
 
 /*
- * Searches query backward.
+ * Writes the tail of content in place after the unchanged prefix of the file
+ * on passed path, cuts the rest and flushes the file to the disk.
  *
- * Returns 1 if result found, 0 if no result and -1 if starting index is
- * invalid.
+ * Returns 0 on success and -1 on error.
+ */
+static int file_save_tail(struct file_saving *, const char *);
+
+/*
+ * Appends chars to the content. Joins them with the last buffer if they are
+ * right after it. `NULL` chars are the next chars of the own lines copy.
  *
- * Sets `EINVAL` if index is invalid.
+ * Returns 0 on success and -1 on error.
  */
-static int line_search_bwd(const struct line *, size_t *, const char *);
+static int file_saving_add(struct file_saving *, const char *, size_t);
 
 /*
- * Searches query forward.
+ * Gathers content of the file to save it to passed path or to the path of the
+ * file if it is `NULL`. Pieces are referred without copying because original
+ * content is never modified. Own lines are copied. Resets dirty flag, so it
+ * shows changes after the gathering.
  *
- * Returns 1 if result found, 0 if no result and -1 if starting index is
- * invalid.
+ * Returns pointer to the saving on success and `NULL` on error.
+ */
+static struct file_saving *file_saving_alloc(struct file *, const char *);
+
+/*
+ * Copies own line's chars with line break and appends them to the content.
  *
- * Sets `EINVAL` if index is invalid.
+ * Returns 0 on success and -1 on error.
  */
-static int line_search_fwd(const struct line *, size_t *, const char *);
+static int file_saving_copy(struct file_saving *, const char *, size_t);
 
 /*
- * Writes a line to the file with `'\n'` at the end.
+ * Finishes the saving and frees it. Restores dirty flag if the saving failed.
+ * Marks the journal as saved if the file is saved to its path and there are
+ * no changes after the gathering.
  *
- * Returns written bytes count on success and 0 on error.
+ * Returns size of the saved file on success and 0 on error.
  */
-static size_t line_write(const struct line *, FILE *);
+static size_t file_saving_end(struct file *, struct file_saving *);
 
-int
-file_absorb_next_line(struct file *const file, const size_t idx)
-{
-	int ret;
-	struct line next;
-	struct line *curr;
+/*
+ * Frees the saving.
+ */
+static void file_saving_free(struct file_saving *);
 
-	/* Remove next line. */
-	ret = vec_rm(file->lines, idx + 1, &next);
-	if (-1 == ret)
-		return -1;
+/*
+ * Thread's start routine, which saves the content.
+ *
+ * Always returns `NULL`.
+ */
+static void *file_saving_run(void *);
 
-	/* Append current line with next line's chars if next line is not empty. */
-	if (vec_len(next.chars) > 0) {
-		/* Get current line here because vector may realloc after removing. */
-		curr = vec_get(file->lines, idx);
-		if (NULL == curr)
-			goto ret_free;
+/*
+ * Saves the content to its path and marks the saving as done with the error
+ * number on error. The target of symbolic link is saved.
+ */
+static void file_saving_save(struct file_saving *);
 
-		ret = line_append(curr, vec_items(next.chars), vec_len(next.chars));
-		if (-1 == ret)
-			goto ret_free;
-	}
+/*
+ * Checks that only the tail of the file after the first changed line can be
+ * written in place. The file must be saved to its path and must not be changed
+ * by others after the last save. The unchanged prefix must be big and the tail
+ * must be small. Pieces which refer to the overwritten part of the mapped file
+ * are copied.
+ *
+ * Returns 1 if the tail can be written, 0 if the whole file must be written and
+ * -1 on error.
+ */
+static int file_saving_use_tail(struct file *, struct file_saving *);
 
-	/* Mark file as dirty. */
-	file->is_dirty = 1;
+/*
+ * Writes the content to the file descriptor by blocks and counts progress.
+ * Many buffers are gathered in one system call.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_saving_write(struct file_saving *, int);
 
-	/* Free removed line. */
-	line_free(&next);
-	return 0;
-ret_free:
-	/* Free removed line. */
-	line_free(&next);
-	return -1;
-}
+/*
+ * Fills the chunk with lines joined with '\n' and offsets of lines in the
+ * chunk. The first line begins from the first passed position and the last
+ * line ends before the second passed position.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_search_chunk_fill(
+	const struct file *, size_t, size_t, size_t, size_t, struct vec *,
+	struct vec *);
 
-static struct file*
-file_alloc(const char *const path)
-{
-	struct file *file;
+/*
+ * Returns index of the chunk's line which contains character at the offset.
+ */
+static size_t file_search_chunk_line(const struct vec *, size_t);
 
-	/* Allocate opaque struct. */
-	file = malloc(sizeof(*file));
-	if (NULL == file)
-		return NULL;
+/*
+ * Searches backward in chunks of lines joined with '\n', so query may
+ * contain line breaks. Chunks overlap to find occurrences on their edges.
+ *
+ * Returns 1 if result found, 0 if no result and -1 on error.
+ */
+static int file_search_chunks_bwd(
+	const struct file *, size_t *, size_t *, const struct search *, size_t);
 
-	/* Copy opened path so as not to depend on external data. */
-	file->path = str_copy(path, strlen(path));
-	if (NULL == file->path)
-		goto err_free_opaque;
+/*
+ * Searches forward in chunks of lines joined with '\n'.
+ *
+ * Returns 1 if result found, 0 if no result and -1 on error.
+ */
+static int file_search_chunks_fwd(
+	const struct file *, size_t *, size_t *, const struct search *, size_t);
 
-	/* Allocate lines container to store lines. */
-	file->lines = vec_alloc(sizeof(struct line), FILE_LINES_CAP_STEP);
-	if (NULL == file->lines)
-		goto err_free_opaque_and_path;
+/*
+ * Remembers that the part has result, so farther parts can stop searching.
+ */
+static void file_search_part_found(struct file_search_part *);
 
-	/* Initialize other fields. */
-	file->is_dirty = 0;
-	return file;
-err_free_opaque_and_path:
-	free(file->path);
-err_free_opaque:
-	free(file);
-	return NULL;
-}
+/*
+ * Checks that closer part already has result.
+ */
+static char file_search_part_is_late(struct file_search_part *);
 
-int
-file_break_line(struct file *const file, const size_t idx, const size_t pos)
-{
-	int ret;
-	struct line new_line;
-	struct line *line;
+/*
+ * Searches in the part and saves result to it.
+ */
+static void file_search_part_run(struct file_search_part *);
 
-	/* Get line. */
-	line = vec_get(file->lines, idx);
-	if (NULL == line)
-		return -1;
+/*
+ * Splits lines in search direction to parts and searches in parts using
+ * several threads. Query must not contain line breaks.
+ *
+ * Returns 1 if result found, 0 if no result and -1 on error.
+ */
+static int file_search_parts(
+	struct file *, size_t *, size_t *, const struct search *, char);
 
-	/* Break line. */
-	ret = line_break(line, pos, &new_line);
-	if (-1 == ret)
-		return -1;
+/*
+ * Searches backward in runs of the part's pieces at once without copying.
+ * Result is written to the part.
+ *
+ * Returns 1 if result found and 0 if no result or closer part has result.
+ */
+static int file_search_runs_bwd(struct file_search_part *);
 
-	/* Insert new line. */
-	ret = vec_ins(file->lines, idx + 1, &new_line, 1);
-	if (-1 == ret)
-		goto err_free;
+/*
+ * Searches forward in runs of the part's pieces at once without copying.
+ *
+ * Returns 1 if result found and 0 if no result or closer part has result.
+ */
+static int file_search_runs_fwd(struct file_search_part *);
 
-	/* Mark file as dirty because of new line. */
-	file->is_dirty = 1;
-	return 0;
-err_free:
-	line_free(&new_line);
-	return -1;
-}
+/*
+ * Allocates threads to search. Do not forget to free them. Parts are searched
+ * in the calling thread if no thread is started.
+ *
+ * Returns pointer to threads on success and `NULL` on error.
+ */
+static struct file_searchers *file_searchers_alloc(void);
 
-void
-file_close(struct file *const file)
-{
-	file_free(file);
-}
+/*
+ * Stops threads to search and frees them.
+ */
+static void file_searchers_free(struct file_searchers *);
 
-int
-file_del_char(struct file *const file, const size_t idx, const size_t pos)
-{
-	int ret;
-	struct line *line;
+/*
+ * Takes parts of searches and searches in them. Used as thread's routine.
+ *
+ * Returns `NULL`.
+ */
+static void *file_searchers_run(void *);
 
-	/* Check line not found. */
-	line = vec_get(file->lines, idx);
-	if (NULL == line)
-		return -1;
+/*
+ * Searches in the first part in the calling thread and in other parts using
+ * threads. Returns when all parts are searched.
+ */
+static void file_searchers_search(
+	struct file_searchers *, struct file_search_part *, size_t);
 
-	/* Delete character in line. */
-	ret = line_del_char(line, pos);
-	if (-1 == ret)
-		return -1;
+/*
+ * Fills undo journal's stamp using state of the file.
+ */
+static void file_stamp(const struct stat *, struct undo_stamp *);
 
-	/* Mark file as dirty. */
-	file->is_dirty = 1;
-	return 0;
-}
+/*
+ * Flushes the entry of passed path in its directory to the disk.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_sync_dir(const char *);
 
-int
-file_del_line(struct file *const file, const size_t idx)
-{
-	int ret;
-	struct line line;
+/*
+ * Calculates length of the text's first line. Length of the line break is
+ * written to the passed pointer or 0 if there is no line break.
+ *
+ * Returns length of the first line without line break.
+ */
+static size_t file_text_line_len(const char *, size_t, size_t *);
 
-	/* Remember that file must contain at least one line. */
-	if (vec_len(file->lines) <= 1) {
-		errno = ENOSYS;
-		return -1;
-	}
+/*
+ * Opens the user's private dir of undo journals in spare dir. Creates it if
+ * there is no such dir.
+ *
+ * Returns descriptor of the dir on success and -1 on error.
+ */
+static int file_undo_dir_open(void);
 
-	/* Remove line using index. */
-	ret = vec_rm(file->lines, idx, &line);
-	if (-1 == ret)
-		return -1;
-	line_free(&line);
+/*
+ * Checks that the file is owned by the user and is not accessible by group
+ * and others.
+ */
+static char file_undo_is_private(const struct stat *);
 
-	/* Mark file as dirty because of deleted line. */
-	file->is_dirty = 1;
-	return 0;
-}
+/*
+ * Builds name of the undo journal in private dir. Name depends on the real
+ * path of the file. The buffer must have a capacity one greater than passed
+ * length for a null byte.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_undo_name(const struct file *, char *, size_t);
 
-static void
-file_free(struct file *const file)
-{
-	struct line *lines;
-	size_t len;
+/*
+ * Writes all passed buffers to the file descriptor. Buffers are modified if
+ * the write is partial.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int file_write_iovs(int, struct iovec *, int);
 
-	/* Get lines and lines count. */
-	lines = vec_items(file->lines);
-	len = vec_len(file->lines);
+/*
+ * Appends passed chars to line and marks render outdated.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_append(struct slab *, struct line *, const char *, size_t);
 
-	/* Free lines . */
-	while (len-- > 0)
-		line_free(&lines[len]);
-	vec_free(file->lines);
+/*
+ * Breaks the line at passed index. Writes broken right part to the passed
+ * line.
+ *
+ * Returns 0 on success an -1 on error.
+ */
+int line_break(struct slab *, struct line *, size_t, struct line *);
 
-	/* Freeing the path since we cloned it earlier. */
+/*
+ * Calculates render's length using characters starting from passed index.
+ * Passed expanded column must correspond to the index.
+ */
+static size_t line_calc_render_len(const struct line *, size_t, size_t);
+
+/*
+ * Returns pointer to line's characters. The line may be a piece of original
+ * buffer, so do not modify them.
+ */
+static const char *line_chars(const struct line *);
+
+/*
+ * Finds the first column which is expanded to at least passed expanded column
+ * or line's length. The line must have up to date render.
+ */
+static size_t line_col_by_exp(const struct line *, size_t);
+
+/*
+ * Cuts a line, shrinks its capacity and marks render outdated. The argument
+ * specifies how many first characters will remain.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_cut(struct slab *, struct line *, size_t);
+
+/*
+ * Deletes characters from the line at passed index.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_del(struct slab *, struct line *, size_t, size_t);
+
+/*
+ * Deletes character from line at passed index and marks render outdated.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int line_del_char(struct slab *, struct line *, size_t);
+
+/*
+ * Expands passed column with tabs starting from the closest remembered
+ * expanded column before it. Render before the column must be up to date if
+ * the line has render.
+ */
+static size_t line_exp_col(const struct line *, size_t);
+
+/*
+ * Returns line's own buffer and render to the slab.
+ */
+static void line_free(struct slab *, struct line *);
+
+/*
+ * Initializes empty line with own content. Do not forget to free it.
+ */
+static void line_init(struct line *);
+
+/*
+ * Inserts characters to the line at passed index.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_ins(
+	struct slab *, struct line *, size_t, const char *, size_t);
+
+/*
+ * Inserts character to line at passed index and marks render outdated.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int line_ins_char(struct slab *, struct line *, size_t, char);
+
+/*
+ * Returns length of line's characters.
+ */
+static size_t line_len(const struct line *);
+
+/*
+ * Marks render outdated starting from passed index. Render will be updated
+ * on next access.
+ */
+static void line_outdate_render(struct line *, size_t);
+
+/*
+ * Moves piece's characters to line's own buffer. Does nothing if line already
+ * has own buffer.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_own(struct slab *, struct line *);
+
+/*
+ * Returns pointer to own content of the line. The line must not be a piece.
+ */
+static char *line_own_chars(struct line *);
+
+/*
+ * Updates outdated part of render how it look in the window. Grows render
+ * buffer if needed. Does nothing if render is up to date. Lines without tabs
+ * look as is, so they are not rendered.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_render(struct slab *, struct line *);
+
+/*
+ * Renders line characters in existing buffer how it look in the window
+ * starting from passed index. Passed expanded column must correspond to the
+ * index. Remembers expanded columns of every few characters. Make sure that
+ * capacities of render buffer and expanded columns are big enough.
+ */
+static void line_render_no_alloc(struct line *, size_t, size_t);
+
+/*
+ * Moves content to own buffer with at least passed capacity. Capacity grows
+ * at least in two times, so appending is fast. Does nothing if own buffer is
+ * already enough.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_reserve(struct slab *, struct line *, size_t);
+
+/*
+ * Moves content to own buffer with at least passed capacity which must fit the
+ * content.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_resize(struct slab *, struct line *, size_t);
+
+/*
+ * Moves content to smaller own buffer if too much space is unused.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int line_shrink_if_needed(struct slab *, struct line *);
+
+/*
+ * Returns weight of the line in the tree of lines which is its length in the
+ * saved file including line break, so offsets of lines are known.
+ */
+static size_t line_weigh(const void *);
+
+
+int
+file_absorb_next_line(struct file *const file, const size_t idx)
+{
+	int ret;
+	size_t pos;
+	size_t weight;
+	struct line next;
+	struct line *curr;
+
+	/* Lines are joined contiguous. */
+	file_gap_close(file);
+
+	/* Remove next line. */
+	ret = tree_rm(file->lines, idx + 1, &next);
+	if (-1 == ret)
+		return -1;
+
+	/* Get current line here because tree may move it after removing. */
+	curr = tree_get(file->lines, idx);
+	if (NULL == curr)
+		goto ret_free;
+	pos = line_len(curr);
+	weight = line_weigh(curr);
+
+	/* Append current line with next line's chars if next line is not empty. */
+	if (line_len(&next) > 0) {
+		ret = line_append(
+			file->slab, curr, line_chars(&next), line_len(&next));
+		if (-1 == ret)
+			goto ret_free;
+		tree_reweigh(file->lines, idx, weight);
+	}
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+
+	/* Free removed line. */
+	line_free(file->slab, &next);
+
+	/* Remember where line is absorbed to break it on undo. */
+	ret = file_journal(file, UNDO_OP_ABSORB_NEXT_LINE, idx, pos, NULL, 0);
+	return ret;
+ret_free:
+	/* Free removed line. */
+	line_free(file->slab, &next);
+	return -1;
+}
+
+static int
+file_add_lines(
+	struct file *const file, const struct line *const lines, size_t *const len)
+{
+	int ret;
+
+	ret = tree_ins(file->lines, tree_len(file->lines), lines, *len);
+	*len = 0;
+	return ret;
+}
+
+static struct file*
+file_alloc(const char *const path)
+{
+	struct file *file;
+
+	/* Allocate opaque struct. */
+	file = malloc(sizeof(*file));
+	if (NULL == file)
+		return NULL;
+
+	/* Copy opened path so as not to depend on external data. */
+	file->path = str_copy(path, strlen(path));
+	if (NULL == file->path)
+		goto err_free_opaque;
+
+	/* Allocate lines container to store lines. */
+	file->lines = tree_alloc(sizeof(struct line), line_weigh);
+	if (NULL == file->lines)
+		goto err_free_opaque_and_path;
+
+	/* Allocate journal of changes. */
+	file->undo = undo_alloc(CFG_UNDO_JOURNAL_SIZE);
+	if (NULL == file->undo)
+		goto err_free_opaque_path_and_lines;
+
+	/* Allocate storage of lines' own contents and renders. */
+	file->slab = slab_alloc();
+	if (NULL == file->slab)
+		goto err_free_opaque_path_lines_and_undo;
+
+	/* Initialize other fields. Changes are journaled after reading. */
+	file->is_dirty = 0;
+	file->orig = NULL;
+	file->orig_len = 0;
+	file->is_mapped = 0;
+	file->is_mapped_saved = 0;
+	file->changed_idx = SIZE_MAX;
+	file->gap_idx = SIZE_MAX;
+	file->gap_pos = 0;
+	file->is_gap_plain = 0;
+	file->is_journaled = 0;
+	file->saving = NULL;
+	file->searchers = NULL;
+	return file;
+err_free_opaque_path_lines_and_undo:
+	undo_free(file->undo);
+err_free_opaque_path_and_lines:
+	tree_free(file->lines);
+err_free_opaque_and_path:
 	free(file->path);
-	/* Free allocated opaque struct. */
+err_free_opaque:
 	free(file);
+	return NULL;
+}
+
+static void
+file_attach_undo(struct file *const file, const struct stat *const info)
+{
+	int ret;
+	int fd;
+	int dir_fd;
+	struct stat journal;
+	struct undo_stamp stamp;
+	char name[CFG_SPARE_PATH_MAX_LEN + 1];
+	const int flags = O_RDWR | O_CREAT | O_APPEND | O_NOFOLLOW | O_CLOEXEC;
+
+	/* Open or create the journal's file which is readable only by owner. */
+	ret = file_undo_name(file, name, CFG_SPARE_PATH_MAX_LEN);
+	if (-1 == ret)
+		return;
+	dir_fd = file_undo_dir_open();
+	if (-1 == dir_fd)
+		return;
+	fd = openat(dir_fd, name, flags, 0600);
+	/* Errors checking is useless here. */
+	close(dir_fd);
+	if (-1 == fd)
+		return;
+
+	/* Do not truncate or write the file which may be linked to other one. */
+	ret = fstat(fd, &journal);
+	if (-1 == ret || !S_ISREG(journal.st_mode) || 1 != journal.st_nlink)
+		goto err_close;
+	if (!file_undo_is_private(&journal))
+		goto err_close;
+
+	/* Restore the journal if the file is not changed after the last save. */
+	file_stamp(info, &stamp);
+	undo_attach(file->undo, fd, &stamp);
+	return;
+err_close:
+	/* Errors checking is useless here. */
+	close(fd);
+}
+
+int
+file_break_line(struct file *const file, const size_t idx, const size_t pos)
+{
+	int ret;
+	size_t weight;
+	struct line new_line;
+	struct line *line;
+
+	/* Indexes of lines after broken one are changed. */
+	file_gap_close(file);
+
+	/* Get line. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+	weight = line_weigh(line);
+
+	/* Break line. Line may be already cut on error. */
+	ret = line_break(file->slab, line, pos, &new_line);
+	tree_reweigh(file->lines, idx, weight);
+	if (-1 == ret)
+		return -1;
+
+	/* Insert new line. */
+	ret = tree_ins(file->lines, idx + 1, &new_line, 1);
+	if (-1 == ret)
+		goto err_free;
+
+	/* Mark file as dirty because of new line. */
+	file_mark_dirty(file, idx);
+
+	/* Journal the change. */
+	ret = file_journal(file, UNDO_OP_BREAK_LINE, idx, pos, NULL, 0);
+	return ret;
+err_free:
+	line_free(file->slab, &new_line);
+	return -1;
+}
+
+void
+file_close(struct file *const file)
+{
+	/* Wait the saving to finish it. */
+	if (NULL != file->saving) {
+		if (file->saving->is_threaded)
+			pthread_join(file->saving->thread, NULL);
+		file_saving_end(file, file->saving);
+	}
+	file_free(file);
+}
+
+int
+file_del_char(struct file *const file, const size_t idx, const size_t pos)
+{
+	int ret;
+	char ch;
+	size_t weight;
+	struct line *line;
+
+	/* Check line not found. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+
+	/* Validate position. */
+	if (pos >= line_len(line)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Delete character after gap of long line or directly from short one. */
+	weight = line_weigh(line);
+	ret = file_gap_open(file, idx, pos);
+	if (-1 == ret)
+		return -1;
+	if (1 == ret) {
+		/* Remember deleted character to insert it on undo. */
+		ch = line_own_chars(line)[pos + line->cap - line->len];
+		line->len--;
+		line_outdate_render(line, pos);
+	} else {
+		ch = line_chars(line)[pos];
+		ret = line_del_char(file->slab, line, pos);
+	}
+
+	/* Update weights even on error because length may be already changed. */
+	tree_reweigh(file->lines, idx, weight);
+	if (-1 == ret)
+		return -1;
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+
+	/* Journal the change. */
+	ret = file_journal(file, UNDO_OP_DEL_CHAR, idx, pos, &ch, 1);
+	return ret;
+}
+
+int
+file_del_line(struct file *const file, const size_t idx)
+{
+	int ret;
+	struct line line;
+
+	/* Remember that file must contain at least one line. */
+	if (tree_len(file->lines) <= 1) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+	/* Indexes of lines after deleted one are changed. */
+	file_gap_close(file);
+
+	/* Remove line using index. */
+	ret = tree_rm(file->lines, idx, &line);
+	if (-1 == ret)
+		return -1;
+
+	/* Mark file as dirty because of deleted line. */
+	file_mark_dirty(file, idx);
+
+	/* Journal deleted characters before freeing the line. */
+	ret = file_journal(
+		file, UNDO_OP_DEL_LINE, idx, 0, line_chars(&line), line_len(&line));
+	line_free(file->slab, &line);
+	return ret;
+}
+
+static int
+file_del_text(
+	struct file *const file,
+	const size_t idx,
+	const size_t pos,
+	const char *const text,
+	const size_t len)
+{
+	int ret;
+	size_t i;
+	size_t text_line_len = 0;
+	size_t brk_len = 0;
+	size_t weight;
+	struct line *line;
+	struct line *last;
+	size_t brks_cnt = 0;
+
+	/* Count line breaks and the length of the last line of the text. */
+	for (i = 0; i < len; i += text_line_len + brk_len) {
+		text_line_len = file_text_line_len(&text[i], len - i, &brk_len);
+		brks_cnt += brk_len > 0;
+	}
+	if (brks_cnt > 0 && brk_len > 0)
+		text_line_len = 0;
+
+	/* Get line. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+	weight = line_weigh(line);
+
+	/* Just delete characters if there is no line breaks. */
+	if (0 == brks_cnt) {
+		ret = line_del(file->slab, line, pos, len);
+		tree_reweigh(file->lines, idx, weight);
+		if (-1 == ret)
+			return -1;
+		file_mark_dirty(file, idx);
+		return 0;
+	}
+
+	/* Get the last line of inserted text. */
+	last = tree_get(file->lines, idx + brks_cnt);
+	if (NULL == last)
+		return -1;
+
+	/* Join line's part before the text and last line's part after the text. */
+	ret = line_own(file->slab, line);
+	if (-1 == ret)
+		return -1;
+	ret = line_cut(file->slab, line, pos);
+	if (0 == ret)
+		ret = line_append(
+			file->slab,
+			line,
+			&line_chars(last)[text_line_len],
+			line_len(last) - text_line_len
+		);
+	tree_reweigh(file->lines, idx, weight);
+	if (-1 == ret)
+		return -1;
+
+	/* Remove lines of the text after the first one at once. */
+	for (i = idx + 1; i <= idx + brks_cnt; i++)
+		line_free(file->slab, tree_get(file->lines, i));
+	ret = tree_rm_range(file->lines, idx + 1, brks_cnt);
+	if (-1 == ret)
+		return -1;
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+	return 0;
+}
+
+static void
+file_free(struct file *const file)
+{
+	/* Stop threads before freeing lines which they may search. */
+	if (NULL != file->searchers)
+		file_searchers_free(file->searchers);
+
+	/* Free lines with all their own buffers and renders at once. */
+	slab_free(file->slab);
+	tree_free(file->lines);
+	undo_free(file->undo);
+
+	/* Free original content after lines because they may refer to it. */
+	if (file->is_mapped)
+		/* Errors checking is useless here. */
+		munmap(file->orig, file->orig_len);
+	else
+		free(file->orig);
+	/* Freeing the path since we cloned it earlier. */
+	free(file->path);
+	/* Free allocated opaque struct. */
+	free(file);
+}
+
+static void
+file_gap_close(struct file *const file)
+{
+	struct line *line;
+
+	/* There is no line with gap. */
+	if (SIZE_MAX == file->gap_idx)
+		return;
+
+	/* Move gap to the end where it is just unused capacity. */
+	line = tree_get(file->lines, file->gap_idx);
+	file_gap_move(file, line->len);
+	file->gap_idx = SIZE_MAX;
+
+	/* Errors are ignored because not shrunk line is still valid. */
+	line_shrink_if_needed(file->slab, line);
+}
+
+static void
+file_gap_move(struct file *const file, const size_t pos)
+{
+	struct line *const line = tree_get(file->lines, file->gap_idx);
+	char *const chars = line_own_chars(line);
+	const size_t gap_len = line->cap - line->len;
+	const size_t gap_pos = file->gap_pos;
+
+	/* Move characters between positions to the other side of the gap. */
+	if (pos < gap_pos)
+		memmove(&chars[pos + gap_len], &chars[pos], gap_pos - pos);
+	else
+		memmove(&chars[gap_pos], &chars[gap_pos + gap_len], pos - gap_pos);
+	file->gap_pos = pos;
+}
+
+static int
+file_gap_open(struct file *const file, const size_t idx, const size_t pos)
+{
+	int ret;
+	struct line *line;
+
+	/* Only one line has gap. */
+	if (idx != file->gap_idx)
+		file_gap_close(file);
+
+	/* Get line and validate position. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+	if (pos > line_len(line)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Moving of short line's content is cheap, so gap is not needed. */
+	if (line_len(line) < FILE_GAP_MIN_LEN) {
+		file_gap_close(file);
+		return 0;
+	}
+
+	if (idx != file->gap_idx) {
+		/* Move content to own buffer with unused capacity at the end. */
+		ret = line_reserve(file->slab, line, line->len + 1);
+		if (-1 == ret)
+			return -1;
+		file->gap_idx = idx;
+		file->gap_pos = line->len;
+		file->is_gap_plain = NULL == memchr(line_chars(line), '\t', line->len);
+	} else if (line->len == line->cap) {
+		/* Grow the line with gap at the end as usual line. */
+		file_gap_move(file, line->len);
+		ret = line_reserve(file->slab, line, line->len + 1);
+		if (-1 == ret)
+			return -1;
+	}
+
+	/* Move gap to the position. */
+	file_gap_move(file, pos);
+	return 1;
+}
+
+static int
+file_index_lines(struct file *const file)
+{
+	int ret;
+	struct line lines[FILE_INDEX_LINES_CNT];
+	size_t len = 0;
+	char *start = file->orig;
+	char *ptr = file->orig;
+	const char *const end = file->orig + file->orig_len;
+#ifdef SCAN_VEC_LOAD
+	unsigned mask;
+	const scan_vec eol = SCAN_VEC_SET1('\n');
+
+	/* Find all line breaks in the vector and add lines ending with them. */
+	for (; (size_t)(end - ptr) >= sizeof(scan_vec); ptr += sizeof(scan_vec)) {
+		/* Append found lines if lines of the vector may not fit. */
+		if (len > FILE_INDEX_LINES_CNT - sizeof(scan_vec)) {
+			ret = file_add_lines(file, lines, &len);
+			if (-1 == ret)
+				return -1;
+		}
+		for (mask = SCAN_VEC_EQ_MASK(SCAN_VEC_LOAD(ptr), eol); 0 != mask;) {
+			file_init_piece(&lines[len++], start, ptr + __builtin_ctz(mask));
+			start = ptr + __builtin_ctz(mask) + 1;
+			mask &= mask - 1;
+		}
+	}
+#endif
+	/* Find line breaks in the rest. */
+	while (NULL != (ptr = memchr(start, '\n', end - start))) {
+		if (FILE_INDEX_LINES_CNT == len) {
+			ret = file_add_lines(file, lines, &len);
+			if (-1 == ret)
+				return -1;
+		}
+		file_init_piece(&lines[len++], start, ptr);
+		start = ptr + 1;
+	}
+
+	/* Last line may not have '\n' at the end. */
+	if (FILE_INDEX_LINES_CNT == len) {
+		ret = file_add_lines(file, lines, &len);
+		if (-1 == ret)
+			return -1;
+	}
+	if (start < end)
+		file_init_piece(&lines[len++], start, end);
+
+	ret = file_add_lines(file, lines, &len);
+	return ret;
+}
+
+static void
+file_init_piece(
+	struct line *const line, char *const start, const char *const end)
+{
+	/* Line is a piece and is not rendered until it is accessed. */
+	line->chars.ptr = start;
+	line->len = end - start;
+	line->cap = 0;
+	line->render = NULL;
+}
+
+int
+file_ins_char(
+	struct file *const file, const size_t idx, const size_t pos, const char ch)
+{
+	int ret;
+	size_t weight;
+	struct line *line;
+
+	/* Insert character to gap of long line or directly to short one. */
+	ret = file_gap_open(file, idx, pos);
+	if (-1 == ret)
+		return -1;
+	line = tree_get(file->lines, idx);
+	weight = line_weigh(line);
+	if (1 == ret) {
+		line_own_chars(line)[file->gap_pos++] = ch;
+		line->len++;
+		line_outdate_render(line, pos);
+		if ('\t' == ch)
+			file->is_gap_plain = 0;
+	} else {
+		ret = line_ins_char(file->slab, line, pos, ch);
+		if (-1 == ret)
+			return -1;
+	}
+	tree_reweigh(file->lines, idx, weight);
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+
+	/* Journal the change. Sequential characters are joined in the journal. */
+	ret = file_journal(file, UNDO_OP_INS_CHARS, idx, pos, &ch, 1);
+	return ret;
+}
+
+int
+file_ins_text(
+	struct file *const file,
+	const size_t idx,
+	const size_t pos,
+	const char *const text,
+	const size_t len)
+{
+	int ret;
+	size_t i;
+	size_t first_len;
+	size_t text_line_len;
+	size_t brk_len;
+	size_t weight;
+	struct line *line;
+	size_t brks_cnt = 0;
+	size_t new_cnt = 0;
+	struct line *new_lines;
+
+	/* Text is inserted to contiguous line. */
+	file_gap_close(file);
+
+	/* Count line breaks in the text. */
+	for (i = 0; i < len; i += text_line_len + brk_len) {
+		text_line_len = file_text_line_len(&text[i], len - i, &brk_len);
+		brks_cnt += brk_len > 0;
+	}
+
+	/* Get line and validate position. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+	if (pos > line_len(line)) {
+		errno = EINVAL;
+		return -1;
+	}
+	weight = line_weigh(line);
+
+	/* Just insert the text if there is no line breaks. */
+	if (0 == brks_cnt) {
+		ret = line_ins(file->slab, line, pos, text, len);
+		if (-1 == ret)
+			return -1;
+		tree_reweigh(file->lines, idx, weight);
+		file_mark_dirty(file, idx);
+		ret = file_journal(file, UNDO_OP_INS_TEXT, idx, pos, text, len);
+		return ret;
+	}
+
+	/* Allocate new lines. */
+	new_lines = malloc(brks_cnt * sizeof(*new_lines));
+	if (NULL == new_lines)
+		return -1;
+
+	/* Fill new lines with the text's lines after the first one. */
+	first_len = file_text_line_len(text, len, &brk_len);
+	i = first_len + brk_len;
+	for (; new_cnt < brks_cnt; i += text_line_len + brk_len) {
+		text_line_len = file_text_line_len(&text[i], len - i, &brk_len);
+		line_init(&new_lines[new_cnt]);
+		new_cnt++;
+
+		ret = line_append(
+			file->slab, &new_lines[new_cnt - 1], &text[i], text_line_len);
+		if (-1 == ret)
+			goto err_free;
+	}
+
+	/* Move line's part after position to the last new line. */
+	ret = line_append(
+		file->slab,
+		&new_lines[new_cnt - 1],
+		&line_chars(line)[pos],
+		line_len(line) - pos
+	);
+	if (-1 == ret)
+		goto err_free;
+	if (0 == line->cap) {
+		line->len = pos;
+		line_outdate_render(line, pos);
+	} else {
+		ret = line_cut(file->slab, line, pos);
+		if (-1 == ret)
+			goto err_reweigh;
+	}
+
+	/* Append the first line of the text. */
+	ret = line_append(file->slab, line, text, first_len);
+	if (-1 == ret)
+		goto err_reweigh;
+	tree_reweigh(file->lines, idx, weight);
+
+	/* Insert new lines. */
+	ret = tree_ins(file->lines, idx + 1, new_lines, new_cnt);
+	if (-1 == ret)
+		goto err_free;
+	free(new_lines);
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+
+	/* Journal the whole text as one change. */
+	ret = file_journal(file, UNDO_OP_INS_TEXT, idx, pos, text, len);
+	return ret;
+err_reweigh:
+	/* Line is already cut. */
+	tree_reweigh(file->lines, idx, weight);
+err_free:
+	while (new_cnt-- > 0)
+		line_free(file->slab, &new_lines[new_cnt]);
+	free(new_lines);
+	return -1;
+}
+
+int
+file_ins_empty_line(struct file *const file, const size_t idx)
+{
+	int ret;
+	struct line empty_line;
+
+	/* Indexes of lines after inserted one are changed. */
+	file_gap_close(file);
+
+	/* Initialize empty line. */
+	line_init(&empty_line);
+
+	/* Insert empty line. */
+	ret = tree_ins(file->lines, idx, &empty_line, 1);
+	if (-1 == ret) {
+		line_free(file->slab, &empty_line);
+		return -1;
+	}
+
+	/* Mark file as dirty. */
+	file_mark_dirty(file, idx);
+
+	/* Journal the change. */
+	ret = file_journal(file, UNDO_OP_INS_EMPTY_LINE, idx, 0, NULL, 0);
+	return ret;
+}
+
+char
+file_is_dirty(const struct file *const file)
+{
+	return file->is_dirty || NULL != file->saving;
+}
+
+char
+file_is_saving(const struct file *const file)
+{
+	return NULL != file->saving;
+}
+
+char
+file_is_undo_synced(const struct file *const file)
+{
+	return undo_is_synced(file->undo);
+}
+
+static int
+file_journal(
+	struct file *const file,
+	const enum undo_op op,
+	const size_t idx,
+	const size_t pos,
+	const char *const chars,
+	const size_t len)
+{
+	int ret;
+	struct undo_rec rec;
+
+	/* Changes are not journaled during reading, undo and redo. */
+	if (!file->is_journaled)
+		return 0;
+
+	/* Write record to the journal. */
+	rec.op = op;
+	rec.idx = idx;
+	rec.pos = pos;
+	rec.chars = chars;
+	rec.len = len;
+	ret = undo_push(file->undo, &rec);
+	return ret;
+}
+
+int
+file_line(
+	struct file *const file, const size_t idx, struct pub_line *const line)
+{
+	int ret;
+
+	/* The whole line is the head of any length. */
+	ret = file_line_head(file, idx, SIZE_MAX, line);
+	return ret;
+}
+
+int
+file_line_col_by_exp(
+	struct file *const file,
+	const size_t idx,
+	const size_t exp,
+	size_t *const col)
+{
+	int ret;
+	struct line *line;
+
+	/* Get line. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+
+	/* Edited line without tabs looks as is. */
+	if (idx == file->gap_idx && file->is_gap_plain) {
+		*col = MIN(exp, line_len(line));
+		return 0;
+	}
+
+	/* Render needs the whole edited line. */
+	if (idx == file->gap_idx)
+		file_gap_move(file, line_len(line));
+
+	/* Find column using remembered columns of render. */
+	ret = line_render(file->slab, line);
+	if (-1 == ret)
+		return -1;
+	if (NULL == line->render)
+		*col = MIN(exp, line_len(line));
+	else
+		*col = line_col_by_exp(line, exp);
+	return 0;
+}
+
+int
+file_line_exp_col(
+	struct file *const file,
+	const size_t idx,
+	const size_t col,
+	size_t *const exp)
+{
+	int ret;
+	struct line *line;
+
+	/* Get line. */
+	line = tree_get(file->lines, idx);
+	if (NULL == line)
+		return -1;
+
+	/* Edited line without tabs looks as is. */
+	if (idx == file->gap_idx && file->is_gap_plain) {
+		*exp = MIN(col, line_len(line));
+		return 0;
+	}
+
+	/* Render needs the whole edited line. */
+	if (idx == file->gap_idx)
+		file_gap_move(file, line_len(line));
+
+	/* Expand column using remembered columns of render. */
+	ret = line_render(file->slab, line);
+	if (-1 == ret)
+		return -1;
+	if (NULL == line->render)
+		*exp = MIN(col, line_len(line));
+	else
+		*exp = line_exp_col(line, col);
+	return 0;
+}
+
+int
+file_line_head(
+	struct file *const file,
+	const size_t idx,
+	const size_t len,
+	struct pub_line *const line)
+{
+	const struct line *internal;
+
+	/* Get internal line struct. */
+	internal = tree_get(file->lines, idx);
+	if (NULL == internal)
+		return -1;
+
+	/* Move gap of the edited line after the head. */
+	if (idx == file->gap_idx && len > file->gap_pos)
+		file_gap_move(file, MIN(len, line_len(internal)));
+
+	/* Copy pointers and values to public line. Render is not needed here. */
+	line->chars = line_chars(internal);
+	line->len = line_len(internal);
+	line->render = NULL;
+	line->render_len = 0;
+	return 0;
+}
+
+int
+file_line_render(
+	struct file *const file,
+	const size_t idx,
+	const size_t len,
+	struct pub_line *const line)
+{
+	int ret;
+	struct line *internal;
+
+	/* Edited line without tabs looks as is, so only its head is needed. */
+	if (idx == file->gap_idx && file->is_gap_plain) {
+		ret = file_line_head(file, idx, len, line);
+		if (-1 == ret)
+			return -1;
+		line->render = line->chars;
+		line->render_len = line->len;
+		return 0;
+	}
+
+	/* Get internal line struct. */
+	internal = tree_get(file->lines, idx);
+	if (NULL == internal)
+		return -1;
+
+	/* Render needs the whole edited line. */
+	if (idx == file->gap_idx)
+		file_gap_move(file, line_len(internal));
+
+	/* Update outdated part of render. */
+	ret = line_render(file->slab, internal);
+	if (-1 == ret)
+		return -1;
+
+	/* Copy pointers and values to public line. */
+	line->chars = line_chars(internal);
+	line->len = line_len(internal);
+	if (NULL == internal->render) {
+		line->render = line->chars;
+		line->render_len = line->len;
+	} else {
+		line->render = internal->render->chars;
+		line->render_len = internal->render->len;
+	}
+	return 0;
+}
+
+size_t
+file_lines_cnt(const struct file *const file)
+{
+	return tree_len(file->lines);
+}
+
+static int
+file_map_orig(struct file *const file, const int fd)
+{
+	int ret;
+	void *orig;
+	struct stat info;
+
+	/* Get size and type of the file. */
+	ret = fstat(fd, &info);
+	if (-1 == ret)
+		return -1;
+
+	/* Empty and not regular files can not be mapped. */
+	if (!S_ISREG(info.st_mode) || info.st_size <= 0)
+		return 0;
+
+	/* Map the file. Private mapping is enough because it is never modified. */
+	orig = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (MAP_FAILED == orig)
+		return 0;
+
+	/* Use mapping as original content. */
+	file->orig = orig;
+	file->orig_len = info.st_size;
+	file->is_mapped = 1;
+	file->is_mapped_saved = 1;
+	return 1;
+}
+
+static void
+file_mark_dirty(struct file *const file, const size_t idx)
+{
+	file->is_dirty = 1;
+	file->changed_idx = MIN(file->changed_idx, idx);
+}
+
+size_t
+file_offset_of(const struct file *const file, const size_t idx, size_t pos)
+{
+	const struct line *const line = tree_get(file->lines, idx);
+
+	/* Lines before are counted with their breaks. */
+	pos = MIN(pos, line_len(line));
+	return tree_weight_before(file->lines, idx) + pos;
+}
+
+struct file*
+file_open(const char *const path)
+{
+	int ret;
+	int fd;
+	struct stat info;
+	struct file *file;
+
+	/* Allocate opaque struct. */
+	file = file_alloc(path);
+	if (NULL == file)
+		return NULL;
+
+	/* Open file using path. */
+	fd = open(path, O_RDONLY);
+	if (-1 == fd)
+		goto err_free_opaque;
+
+	/* Read lines. */
+	ret = file_read(file, fd);
+	if (-1 == ret)
+		goto err_free_opaque_and_close_file;
+
+	/* Remember state of the file to validate undo journal and saves. */
+	ret = fstat(fd, &info);
+	if (-1 == ret)
+		goto err_free_opaque_and_close_file;
+	file_stamp(&info, &file->saved_stamp);
+
+	/* Close opened file. Mapping remains valid after closing. */
+	ret = close(fd);
+	if (-1 == ret)
+		goto err_free_opaque;
+
+	/* Add empty line if there is no lines. */
+	if (tree_len(file->lines) == 0) {
+		/* Insert empty line and reset dirty flag. */
+		ret = file_ins_empty_line(file, 0);
+		if (-1 == ret)
+			goto err_free_opaque;
+		file->is_dirty = 0;
+	}
+
+	/* Journal changes after reading. */
+	file->is_journaled = 1;
+	if (CFG_UNDO_FILE_IS_ON)
+		file_attach_undo(file, &info);
+	return file;
+err_free_opaque_and_close_file:
+	/* Errors checking is useless here. */
+	close(fd);
+err_free_opaque:
+	file_free(file);
+	return NULL;
+}
+
+const char*
+file_path(const struct file *const file)
+{
+	return file->path;
+}
+
+static size_t
+file_piece_run_begin(
+	const struct file *const file, size_t idx, struct tree_hint *const hint)
+{
+	const struct line *prev;
+	const struct line *line = tree_at(file->lines, idx, hint);
+	const char *const end = line->chars.ptr;
+
+	/* Own line is a run itself. */
+	if (line->cap > 0)
+		return idx;
+
+	/* Limit run to find close occurrences fast. */
+	for (; idx > 0; idx--, line = prev) {
+		if (end - line->chars.ptr >= FILE_SEARCH_CHUNK_SIZE)
+			break;
+
+		/* Check that previous line is a piece which ends right before. */
+		prev = tree_at(file->lines, idx - 1, hint);
+		if (prev->cap > 0)
+			break;
+		if (prev->chars.ptr + prev->len + 1 != line->chars.ptr)
+			break;
+		if ('\n' != prev->chars.ptr[prev->len])
+			break;
+	}
+	return idx;
+}
+
+static size_t
+file_piece_run_end(
+	const struct file *const file, size_t idx, struct tree_hint *const hint)
+{
+	const struct line *next;
+	const size_t lines_cnt = tree_len(file->lines);
+	const struct line *line = tree_at(file->lines, idx, hint);
+	const char *const begin = line->chars.ptr;
+
+	/* Own line is a run itself. */
+	if (line->cap > 0)
+		return idx;
+
+	/* Limit run to find close occurrences fast. */
+	for (; idx + 1 < lines_cnt; idx++, line = next) {
+		/* Check that next line is a piece which begins right after. */
+		next = tree_at(file->lines, idx + 1, hint);
+		if (next->cap > 0)
+			break;
+		if (line->chars.ptr + line->len + 1 != next->chars.ptr)
+			break;
+		if ('\n' != line->chars.ptr[line->len])
+			break;
+		if (next->chars.ptr - begin >= FILE_SEARCH_CHUNK_SIZE)
+			break;
+	}
+	return idx;
+}
+
+static size_t
+file_piece_run_line(
+	const struct file *const file,
+	size_t first,
+	size_t last,
+	const char *const ch)
+{
+	size_t mid;
+	struct tree_hint hint = {NULL, 0, 0};
+
+	/* Find the last line which begins before or at the character. */
+	while (first < last) {
+		mid = last - (last - first) / 2;
+		if (line_chars(tree_at(file->lines, mid, &hint)) <= ch)
+			first = mid;
+		else
+			last = mid - 1;
+	}
+	return first;
+}
+
+void
+file_pos_of_offset(
+	const struct file *const file,
+	const size_t off,
+	size_t *const idx,
+	size_t *const pos)
+{
+	size_t before;
+	const struct line *line;
+
+	/* Find line which covers the offset with its break. */
+	*idx = tree_idx_of_weight(file->lines, off, &before);
+	if (*idx < file_lines_cnt(file)) {
+		*pos = off - before;
+		return;
+	}
+
+	/* Clamp to the end of the last line. */
+	*idx = file_lines_cnt(file) - 1;
+	line = tree_get(file->lines, *idx);
+	*pos = line_len(line);
+}
+
+static int
+file_read(struct file *const file, const int fd)
+{
+	int ret;
+
+	/* Try to map the file to avoid copying of its content. */
+	ret = file_map_orig(file, fd);
+	if (-1 == ret)
+		return -1;
+
+	/* Read all content if the file can not be mapped. */
+	if (0 == ret) {
+		ret = file_read_orig(file, fd);
+		if (-1 == ret)
+			return -1;
+	}
+
+	/* Split readed content into lines. */
+	ret = file_index_lines(file);
+	return ret;
+}
+
+static int
+file_read_orig(struct file *const file, const int fd)
+{
+	int ret;
+	size_t cap;
+	ssize_t readed;
+	char *orig;
+	struct stat info;
+
+	/* Get size of the file to read it with one allocation. */
+	ret = fstat(fd, &info);
+	if (-1 == ret)
+		return -1;
+	/* Reserve one more byte to detect EOF without reallocation. */
+	cap = info.st_size > 0 ? (size_t)info.st_size + 1 : FILE_ORIG_CAP_STEP;
+
+	while (1) {
+		/* Grow the buffer if the file is bigger than expected. */
+		if (NULL == file->orig || file->orig_len == cap) {
+			if (NULL != file->orig)
+				cap *= 2;
+			orig = realloc(file->orig, cap);
+			if (NULL == orig)
+				return -1;
+			file->orig = orig;
+		}
+
+		/* Read next block. */
+		readed = read(
+			fd,
+			&file->orig[file->orig_len],
+			MIN(cap - file->orig_len, FILE_READ_BLOCK_SIZE)
+		);
+
+		/* Check read error. Interrupted read can be restarted. */
+		if (-1 == readed && EINTR != errno)
+			return -1;
+		/* Check end of file reached. */
+		if (0 == readed)
+			return 0;
+		/* It's ok to add signed because of error check before. */
+		if (readed > 0)
+			file->orig_len += readed;
+	}
+}
+
+int
+file_redo(struct file *const file, size_t *const idx, size_t *const pos)
+{
+	int ret;
+	struct undo_rec rec;
+
+	/* Take the last undone change. */
+	ret = undo_next(file->undo, &rec);
+	if (0 == ret)
+		return 0;
+
+	/* Changes are applied to contiguous lines. */
+	file_gap_close(file);
+
+	/* Apply the change again without journaling. */
+	file->is_journaled = 0;
+	ret = file_redo_rec(file, &rec);
+	file->is_journaled = 1;
+	if (-1 == ret)
+		return -1;
+
+	/* Return position of the change. */
+	*idx = rec.idx;
+	*pos = rec.pos;
+	return 1;
+}
+
+static int
+file_redo_rec(struct file *const file, const struct undo_rec *const rec)
+{
+	int ret = 0;
+	size_t weight;
+	struct line *line;
+
+	switch (rec->op) {
+	case UNDO_OP_ABSORB_NEXT_LINE:
+		ret = file_absorb_next_line(file, rec->idx);
+		break;
+	case UNDO_OP_BREAK_LINE:
+		ret = file_break_line(file, rec->idx, rec->pos);
+		break;
+	case UNDO_OP_DEL_CHAR:
+		ret = file_del_char(file, rec->idx, rec->pos);
+		break;
+	case UNDO_OP_DEL_LINE:
+		ret = file_del_line(file, rec->idx);
+		break;
+	case UNDO_OP_INS_CHARS:
+		/* Characters are inserted as is because they have no line breaks. */
+		line = tree_get(file->lines, rec->idx);
+		if (NULL == line)
+			return -1;
+		weight = line_weigh(line);
+		ret = line_ins(file->slab, line, rec->pos, rec->chars, rec->len);
+		tree_reweigh(file->lines, rec->idx, weight);
+		file_mark_dirty(file, rec->idx);
+		break;
+	case UNDO_OP_INS_EMPTY_LINE:
+		ret = file_ins_empty_line(file, rec->idx);
+		break;
+	case UNDO_OP_INS_TEXT:
+		ret = file_ins_text(file, rec->idx, rec->pos, rec->chars, rec->len);
+		break;
+	}
+	return ret;
+}
+
+static int
+file_revert_rec(struct file *const file, const struct undo_rec *const rec)
+{
+	int ret = 0;
+	size_t weight;
+	struct line *line;
+
+	switch (rec->op) {
+	case UNDO_OP_ABSORB_NEXT_LINE:
+		ret = file_break_line(file, rec->idx, rec->pos);
+		break;
+	case UNDO_OP_BREAK_LINE:
+		ret = file_absorb_next_line(file, rec->idx);
+		break;
+	case UNDO_OP_DEL_CHAR:
+		ret = file_ins_char(file, rec->idx, rec->pos, rec->chars[0]);
+		break;
+	case UNDO_OP_DEL_LINE:
+		/* Insert empty line and fill it with deleted characters. */
+		ret = file_ins_empty_line(file, rec->idx);
+		if (-1 == ret || 0 == rec->len)
+			break;
+		line = tree_get(file->lines, rec->idx);
+		if (NULL == line)
+			return -1;
+		weight = line_weigh(line);
+		ret = line_append(file->slab, line, rec->chars, rec->len);
+		tree_reweigh(file->lines, rec->idx, weight);
+		break;
+	case UNDO_OP_INS_CHARS: /* FALLTHROUGH. */
+	case UNDO_OP_INS_TEXT:
+		ret = file_del_text(file, rec->idx, rec->pos, rec->chars, rec->len);
+		break;
+	case UNDO_OP_INS_EMPTY_LINE:
+		ret = file_del_line(file, rec->idx);
+		break;
+	}
+	return ret;
+}
+
+size_t
+file_save(struct file *const file, const char *const custom_path)
+{
+	size_t len;
+	struct file_saving *saving;
+
+	/* Gather content. */
+	saving = file_saving_alloc(file, custom_path);
+	if (NULL == saving)
+		return 0;
+
+	/* Save it in this thread. */
+	file_saving_save(saving);
+	len = file_saving_end(file, saving);
+	return len;
+}
+
+static int
+file_save_atomic(
+	struct file_saving *const saving,
+	const char *const path,
+	const struct stat *const info)
+{
+	int fd;
+	int ret;
+	int err;
+	mode_t mask;
+	mode_t mode;
+	const char *fname;
+	char tmp_path[PATH_MAX];
+
+	/* Temporary file must be on the same file system to rename it. */
+	fname = strrchr(path, '/');
+	fname = NULL == fname ? path : fname + 1;
+	ret = snprintf(
+		tmp_path,
+		sizeof(tmp_path),
+		"%.*s.%s.XXXXXX",
+		(int)(fname - path),
+		path,
+		fname);
+	if (ret < 0 || (size_t)ret >= sizeof(tmp_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	/* Create temporary file. */
+	fd = mkstemp(tmp_path);
+	if (-1 == fd)
+		return -1;
+
+	/* Get mode of the replaced file or the default mode of new files. */
+	if (NULL == info) {
+		mask = umask(0);
+		umask(mask);
+		mode = 0666 & ~mask;
+	} else {
+		/* Only privileged user can change owner, so errors are ignored. */
+		ret = fchown(fd, info->st_uid, info->st_gid);
+		mode = info->st_mode & 07777;
+	}
+
+	/* Set mode after owner, because change of owner resets some bits. */
+	ret = fchmod(fd, mode);
+	if (-1 == ret)
+		goto err_close;
+
+	/* Write content and flush it to the disk before replace. */
+	ret = file_saving_write(saving, fd);
+	if (-1 == ret)
+		goto err_close;
+	ret = fsync(fd);
+	if (-1 == ret)
+		goto err_close;
+
+	/* Close temporary file. */
+	ret = close(fd);
+	if (-1 == ret)
+		goto err_unlink;
+
+	/* Replace the file at once. */
+	ret = rename(tmp_path, path);
+	if (-1 == ret)
+		goto err_unlink;
+
+	/* Content is already safe, so errors of directory flush are ignored. */
+	file_sync_dir(path);
+	return 0;
+err_close:
+	/* Errors checking here is useless. */
+	close(fd);
+err_unlink:
+	/* Remove temporary file and keep the error for the caller. */
+	err = errno;
+	unlink(tmp_path);
+	errno = err;
+	return -1;
+}
+
+int
+file_save_bg(struct file *const file)
+{
+	int ret;
+	struct file_saving *saving;
+
+	/* Only one saving at a time. */
+	if (NULL != file->saving) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	/* Gather content. */
+	saving = file_saving_alloc(file, NULL);
+	if (NULL == saving)
+		return -1;
+
+	/* Save in other thread. Save in this thread if thread is not started. */
+	ret = pthread_create(&saving->thread, NULL, file_saving_run, saving);
+	saving->is_threaded = 0 == ret;
+	if (!saving->is_threaded)
+		file_saving_save(saving);
+	file->saving = saving;
+	return 0;
+}
+
+int
+file_save_bg_poll(
+	struct file *const file, size_t *const written, size_t *const len)
+{
+	char is_done;
+	size_t saved_len;
+	struct file_saving *const saving = file->saving;
+
+	/* Get progress of the saving. */
+	pthread_mutex_lock(&saving->mutex);
+	*written = saving->written;
+	is_done = saving->is_done;
+	pthread_mutex_unlock(&saving->mutex);
+	*len = saving->len;
+	if (!is_done)
+		return 0;
+
+	/* Wait the thread and finish the saving. */
+	if (saving->is_threaded)
+		pthread_join(saving->thread, NULL);
+	file->saving = NULL;
+	saved_len = file_saving_end(file, saving);
+	if (0 == saved_len)
+		return -1;
+	*len = saved_len;
+	return 1;
+}
+
+static int
+file_save_in_place(struct file_saving *const saving, const char *const path)
+{
+	int fd;
+	int ret;
+
+	/* Try to open file. */
+	fd = open(path, O_WRONLY | O_TRUNC);
+	if (-1 == fd)
+		return -1;
+
+	/* Write content to opened file. */
+	ret = file_saving_write(saving, fd);
+	if (-1 == ret) {
+		/* Errors checking here is useless. */
+		close(fd);
+		return -1;
+	}
+
+	/* Close file. */
+	ret = close(fd);
+	return ret;
+}
+
+static int
+file_save_tail(struct file_saving *const saving, const char *const path)
+{
+	int fd;
+	int ret;
+	int err;
+	off_t pos;
+
+	/* Try to open file without truncation. */
+	fd = open(path, O_WRONLY);
+	if (-1 == fd)
+		return -1;
+
+	/* Write the tail after unchanged prefix. */
+	pos = lseek(fd, saving->off, SEEK_SET);
+	if (-1 == pos)
+		goto err_close;
+	ret = file_saving_write(saving, fd);
+	if (-1 == ret)
+		goto err_close;
+
+	/* Cut the rest of old content and flush the file to the disk. */
+	ret = ftruncate(fd, saving->off + saving->len);
+	if (-1 == ret)
+		goto err_close;
+	ret = fsync(fd);
+	if (-1 == ret)
+		goto err_close;
+
+	/* Close file. */
+	ret = close(fd);
+	return ret;
+err_close:
+	/* Close file and keep the error for the caller. */
+	err = errno;
+	close(fd);
+	errno = err;
+	return -1;
+}
+
+size_t
+file_save_to_spare_dir(struct file *const file, char *const path, size_t len)
+{
+	int ret;
+	char date[20];
+	const char *fname;
+
+	/* Get date and time string. */
+	ret = dt_str(date, sizeof(date));
+	if (-1 == ret)
+		return 0;
+
+	/* Get filename. */
+	fname = basename(file->path);
+
+	/* Build full spare path. */
+	ret = snprintf(path, len, "%s/%s_%s", cfg_spare_save_dir, fname, date);
+	if (ret < 0 || (size_t)ret >= len)
+		return 0;
+
+	/* Save file using built path. */
+	return file_save(file, path);
+}
+
+static int
+file_saving_add(
+	struct file_saving *const saving, const char *const chars, const size_t len)
+{
+	size_t cap;
+	const char *end;
+	struct iovec *iovs;
+	struct iovec *iov;
+
+	saving->len += len;
+
+	/* Join with the last buffer if chars are right after it. */
+	if (saving->iovs_cnt > 0) {
+		iov = &saving->iovs[saving->iovs_cnt - 1];
+		end = NULL == iov->iov_base ? NULL : (char *)iov->iov_base + iov->iov_len;
+		if (end == chars) {
+			iov->iov_len += len;
+			return 0;
+		}
+	}
+
+	/* Grow buffers twice if there is no space. */
+	if (saving->iovs_cnt == saving->iovs_cap) {
+		cap = MAX(2 * saving->iovs_cap, FILE_SAVING_IOVS_MIN_CAP);
+		iovs = realloc(saving->iovs, cap * sizeof(*iovs));
+		if (NULL == iovs)
+			return -1;
+		saving->iovs = iovs;
+		saving->iovs_cap = cap;
+	}
+
+	/* Add new buffer. */
+	iov = &saving->iovs[saving->iovs_cnt++];
+	iov->iov_base = (char *)chars;
+	iov->iov_len = len;
+	return 0;
+}
+
+static struct file_saving*
+file_saving_alloc(struct file *const file, const char *const custom_path)
+{
+	int ret;
+	size_t i;
+	size_t last;
+	size_t first;
+	char *own;
+	const char *end;
+	const char *begin;
+	const struct line *line;
+	struct file_saving *saving;
+	static const char brk = '\n';
+	struct tree_hint hint = {NULL, 0, 0};
+	const size_t lines_cnt = tree_len(file->lines);
+	const char *const path = NULL == custom_path ? file->path : custom_path;
+
+	/* Own lines are copied contiguous. */
+	file_gap_close(file);
+
+	/* Allocate opaque struct. */
+	saving = malloc(sizeof(*saving));
+	if (NULL == saving)
+		return NULL;
+
+	/* Copy the path so as not to depend on external data. */
+	saving->path = str_copy(path, strlen(path));
+	if (NULL == saving->path)
+		goto err_free_saving;
+
+	/* Initialize shared state. */
+	ret = pthread_mutex_init(&saving->mutex, NULL);
+	if (0 != ret) {
+		errno = ret;
+		goto err_free_saving_and_path;
+	}
+	saving->is_custom = NULL != custom_path;
+	saving->is_tail = 0;
+	saving->off = 0;
+	saving->iovs = NULL;
+	saving->iovs_cnt = 0;
+	saving->iovs_cap = 0;
+	saving->own = NULL;
+	saving->own_len = 0;
+	saving->own_cap = 0;
+	saving->len = 0;
+	saving->is_threaded = 0;
+	saving->written = 0;
+	saving->is_done = 0;
+	saving->err = 0;
+
+	/* Write only the changed tail of big file if possible. */
+	ret = file_saving_use_tail(file, saving);
+	if (-1 == ret)
+		goto err_free_all;
+	saving->is_tail = 1 == ret;
+	first = saving->is_tail ? MIN(file->changed_idx, lines_cnt) : 0;
+
+	/* Gather content using runs of pieces. */
+	for (i = first; i < lines_cnt; i = last + 1) {
+		line = tree_at(file->lines, i, &hint);
+		begin = line->chars.ptr;
+		last = file_piece_run_end(file, i, &hint);
+		line = tree_at(file->lines, last, &hint);
+
+		/* Copy own line with line break. */
+		if (line->cap > 0) {
+			ret = file_saving_copy(saving, line_chars(line), line_len(line));
+			if (-1 == ret)
+				goto err_free_all;
+			continue;
+		}
+
+		/* Run of pieces contains line breaks between its lines. */
+		end = line->chars.ptr + line->len;
+		ret = file_saving_add(saving, begin, end - begin);
+		if (-1 == ret)
+			goto err_free_all;
+
+		/* Use line break of original content to join with the next run. */
+		if (end < file->orig + file->orig_len && '\n' == *end)
+			ret = file_saving_add(saving, end, 1);
+		else
+			ret = file_saving_add(saving, &brk, 1);
+		if (-1 == ret)
+			goto err_free_all;
+	}
+
+	/* Copy does not move anymore, so point buffers of own lines to it. */
+	own = saving->own;
+	for (i = 0; i < saving->iovs_cnt; i++) {
+		if (NULL == saving->iovs[i].iov_base) {
+			saving->iovs[i].iov_base = own;
+			own += saving->iovs[i].iov_len;
+		}
+	}
+
+	/* Custom path does not save the opened file, so its state is kept. */
+	saving->was_dirty = file->is_dirty;
+	saving->changed_idx = file->changed_idx;
+	if (saving->is_custom)
+		return saving;
+
+	/* Dirty flag shows changes which are not gathered. */
+	file->is_dirty = 0;
+
+	/* Changed line is relative to the saved file. */
+	file->changed_idx = SIZE_MAX;
+	return saving;
+err_free_all:
+	file_saving_free(saving);
+	return NULL;
+err_free_saving_and_path:
+	free(saving->path);
+err_free_saving:
+	free(saving);
+	return NULL;
+}
+
+static int
+file_saving_copy(
+	struct file_saving *const saving, const char *const chars, const size_t len)
+{
+	int ret;
+	char *own;
+	size_t cap;
+
+	/* Grow the copy twice if there is no space. */
+	if (saving->own_len + len + 1 > saving->own_cap) {
+		cap = MAX(2 * saving->own_cap, saving->own_len + len + 1);
+		own = realloc(saving->own, cap);
+		if (NULL == own)
+			return -1;
+		saving->own = own;
+		saving->own_cap = cap;
+	}
+
+	/* Copy chars with line break. */
+	memcpy(&saving->own[saving->own_len], chars, len);
+	saving->own[saving->own_len + len] = '\n';
+	saving->own_len += len + 1;
+
+	/* Copy may move, so buffer is pointed to it after gathering. */
+	ret = file_saving_add(saving, NULL, len + 1);
+	return ret;
+}
+
+static size_t
+file_saving_end(struct file *const file, struct file_saving *const saving)
+{
+	int err;
+	size_t len;
+	struct stat info;
+
+	/* Restore dirty flag and changed line if changes are not saved. */
+	err = saving->err;
+	if (0 != err) {
+		if (!saving->is_custom) {
+			file->is_dirty |= saving->was_dirty;
+			file->changed_idx = MIN(file->changed_idx, saving->changed_idx);
+		}
+		file_saving_free(saving);
+		errno = err;
+		return 0;
+	}
+
+	/* Replaced file is not the mapped one anymore. */
+	if (!saving->is_custom && !saving->is_tail)
+		file->is_mapped_saved = 0;
+
+	/* Remember state of saved file. Errors are ignored. */
+	if (!saving->is_custom && 0 == stat(file->path, &info)) {
+		file_stamp(&info, &file->saved_stamp);
+
+		/* Journal is valid if there are no changes after the gathering. */
+		if (!file->is_dirty)
+			undo_mark_saved(file->undo, &file->saved_stamp);
+	}
+	/* Unchanged prefix of the file is not written, but it is saved. */
+	len = saving->off + saving->len;
+	file_saving_free(saving);
+	return len;
+}
+
+static void
+file_saving_free(struct file_saving *const saving)
+{
+	pthread_mutex_destroy(&saving->mutex);
+	free(saving->own);
+	free(saving->iovs);
+	free(saving->path);
+	free(saving);
+}
+
+static void*
+file_saving_run(void *const arg)
+{
+	file_saving_save(arg);
+	return NULL;
+}
+
+static void
+file_saving_save(struct file_saving *const saving)
+{
+	int ret;
+	int err;
+	struct stat info;
+	char real[PATH_MAX];
+	const char *path = saving->path;
+
+	/* Replace the target of symbolic link instead of the link itself. */
+	if (NULL != realpath(path, real))
+		path = real;
+
+	if (saving->is_tail) {
+		/* Unchanged prefix of the file is kept. */
+		ret = file_save_tail(saving, path);
+	} else {
+		/* Only regular files can be replaced. File may not exist. */
+		ret = stat(path, &info);
+		if (0 == ret && !S_ISREG(info.st_mode))
+			ret = file_save_in_place(saving, path);
+		else if (0 == ret)
+			ret = file_save_atomic(saving, path, &info);
+		else if (ENOENT == errno)
+			ret = file_save_atomic(saving, path, NULL);
+	}
+	err = -1 == ret ? errno : 0;
+
+	/* Mark the saving as done. */
+	pthread_mutex_lock(&saving->mutex);
+	saving->err = err;
+	saving->is_done = 1;
+	pthread_mutex_unlock(&saving->mutex);
+}
+
+static int
+file_saving_use_tail(struct file *const file, struct file_saving *const saving)
+{
+	int ret;
+	size_t i;
+	struct stat info;
+	struct undo_stamp stamp;
+	size_t off;
+	size_t tail_len;
+	struct line *line;
+	struct tree_hint hint = {NULL, 0, 0};
+	const size_t lines_cnt = tree_len(file->lines);
+	const size_t first = MIN(file->changed_idx, lines_cnt);
+	const struct undo_stamp *const saved = &file->saved_stamp;
+
+	/* Custom path is a new file. */
+	if (saving->is_custom)
+		return 0;
+
+	/* Saved file must not be changed by others after the last save. */
+	ret = stat(file->path, &info);
+	if (-1 == ret || !S_ISREG(info.st_mode))
+		return 0;
+	file_stamp(&info, &stamp);
+	if (stamp.size != saved->size || stamp.mtime != saved->mtime)
+		return 0;
+	if (stamp.ino != saved->ino)
+		return 0;
+
+	/* Tail must be small. Lengths of parts are kept in the tree of lines. */
+	off = tree_weight_before(file->lines, first);
+	tail_len = tree_weight_before(file->lines, lines_cnt) - off;
+	if (tail_len > FILE_SAVE_TAIL_MAX_LEN)
+		return 0;
+
+	/* Unchanged prefix must be big and must be in the saved file. */
+	if (off < FILE_SAVE_TAIL_MIN_OFF || off > stamp.size)
+		return 0;
+
+	/* Nothing to write and truncate if the file is not changed. */
+	if (0 == tail_len && off == stamp.size)
+		return 0;
+
+	/*
+	 * Copy pieces which refer to the overwritten part of the mapped file.
+	 * Pieces are only split and removed, so they are in the order of the
+	 * original content and the search stops at the first piece before it.
+	 */
+	for (i = lines_cnt; file->is_mapped_saved && i-- > 0;) {
+		line = tree_at(file->lines, i, &hint);
+		if (line->cap > 0)
+			continue;
+		if ((size_t)(line->chars.ptr + line->len - file->orig) < off)
+			break;
+		ret = line_own(file->slab, line);
+		if (-1 == ret)
+			return -1;
+	}
+	saving->off = off;
+	return 1;
+}
+
+static int
+file_saving_write(struct file_saving *const saving, const int fd)
+{
+	int ret;
+	int cnt;
+	size_t len;
+	const struct iovec *src;
+	struct iovec iovs[FILE_WRITE_IOVS_CNT];
+	size_t i = 0;
+	size_t pos = 0;
+	const size_t iovs_cnt = saving->iovs_cnt;
+
+	while (i < iovs_cnt) {
+		/* Gather buffers up to the block size. Long buffers are split. */
+		len = 0;
+		for (cnt = 0; cnt < FILE_WRITE_IOVS_CNT && i < iovs_cnt; cnt++) {
+			if (len >= FILE_WRITE_BLOCK_SIZE)
+				break;
+			src = &saving->iovs[i];
+			iovs[cnt].iov_base = (char *)src->iov_base + pos;
+			iovs[cnt].iov_len = src->iov_len - pos;
+			if (iovs[cnt].iov_len > FILE_WRITE_BLOCK_SIZE - len)
+				iovs[cnt].iov_len = FILE_WRITE_BLOCK_SIZE - len;
+			len += iovs[cnt].iov_len;
+			pos += iovs[cnt].iov_len;
+			if (pos == src->iov_len) {
+				i++;
+				pos = 0;
+			}
+		}
+
+		/* Write the block. */
+		ret = file_write_iovs(fd, iovs, cnt);
+		if (-1 == ret)
+			return -1;
+
+		/* Count progress. */
+		pthread_mutex_lock(&saving->mutex);
+		saving->written += len;
+		pthread_mutex_unlock(&saving->mutex);
+	}
+	return 0;
 }
 
 int
-file_ins_char(
-	struct file *const file, const size_t idx, const size_t pos, const char ch)
+file_search_bwd(
+	struct file *const file,
+	size_t *const idx,
+	size_t *const pos,
+	const char *const query)
 {
 	int ret;
 	struct line *line;
+	struct search *search;
+	const size_t query_len = strlen(query);
 
-	/* Get line. */
-	line = vec_get(file->lines, idx);
+	/* Lines are searched contiguous. */
+	file_gap_close(file);
+
+	/* Validate accepted position. */
+	line = tree_get(file->lines, *idx);
 	if (NULL == line)
 		return -1;
+	if (*pos > line_len(line)) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	/* Insert new character. */
-	ret = line_ins_char(line, pos, ch);
-	if (-1 == ret)
+	/* Nothing to search. */
+	if (0 == query_len)
+		return 0;
+
+	/* Compile query once for all lines. */
+	search = search_alloc(query, query_len);
+	if (NULL == search)
 		return -1;
 
-	/* Mark file as dirty. */
-	file->is_dirty = 1;
-	return 0;
+	/* Line breaks are only between lines, so search them in joined lines. */
+	if (NULL == memchr(query, '\n', query_len))
+		ret = file_search_parts(file, idx, pos, search, 0);
+	else
+		ret = file_search_chunks_bwd(file, idx, pos, search, query_len);
+	search_free(search);
+	return ret;
 }
 
-int
-file_ins_empty_line(struct file *const file, const size_t idx)
+static int
+file_search_chunk_fill(
+	const struct file *const file,
+	const size_t first,
+	const size_t first_pos,
+	const size_t last,
+	const size_t last_pos,
+	struct vec *const chunk,
+	struct vec *const offsets)
 {
 	int ret;
-	struct line empty_line;
-
-	/* Initialize empty line. */
-	ret = line_init(&empty_line);
+	size_t i;
+	size_t offset;
+	size_t from;
+	size_t to;
+	const struct line *line;
+	struct tree_hint hint = {NULL, 0, 0};
+
+	/* Clear previous chunk. */
+	ret = vec_set_len(chunk, 0);
+	if (-1 == ret)
+		return -1;
+	ret = vec_set_len(offsets, 0);
 	if (-1 == ret)
 		return -1;
 
-	/* Insert empty line. */
-	ret = vec_ins(file->lines, idx, &empty_line, 1);
-	if (-1 == ret) {
-		line_free(&empty_line);
+	for (i = first; i <= last; i++) {
+		line = tree_at(file->lines, i, &hint);
+
+		/* Remember where line begins in the chunk. */
+		offset = vec_len(chunk);
+		ret = vec_append(offsets, &offset, 1);
+		if (-1 == ret)
+			return -1;
+
+		/* Append line's part which is in the chunk. Empty part has no chars. */
+		from = i == first ? first_pos : 0;
+		to = i == last ? last_pos : line_len(line);
+		if (to > from) {
+			ret = vec_append(chunk, line_chars(line) + from, to - from);
+			if (-1 == ret)
+				return -1;
+		}
+
+		/* Join lines with line break. */
+		if (i < last) {
+			ret = vec_append(chunk, "\n", 1);
+			if (-1 == ret)
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static size_t
+file_search_chunk_line(const struct vec *const offsets, const size_t offset)
+{
+	size_t mid;
+	size_t begin = 0;
+	size_t end = vec_len(offsets);
+	const size_t *const items = vec_items(offsets);
+
+	/* Find the last line which begins before or at the offset. */
+	while (end - begin > 1) {
+		mid = begin + (end - begin) / 2;
+		if (items[mid] <= offset)
+			begin = mid;
+		else
+			end = mid;
+	}
+	return begin;
+}
+
+static int
+file_search_chunks_bwd(
+	const struct file *const file,
+	size_t *const idx,
+	size_t *const pos,
+	const struct search *const search,
+	const size_t query_len)
+{
+	int ret = -1;
+	size_t i;
+	size_t first;
+	size_t len;
+	size_t offset;
+	const char *found;
+	size_t *offsets_items;
+	struct vec *chunk;
+	struct vec *offsets;
+	size_t last = *idx;
+	size_t last_pos = *pos;
+	struct tree_hint hint = {NULL, 0, 0};
+	const size_t chunk_size = MAX(FILE_SEARCH_CHUNK_SIZE, 2 * query_len);
+
+	/* Allocate chunk and offsets of its lines. */
+	chunk = vec_alloc(sizeof(char), chunk_size);
+	if (NULL == chunk)
 		return -1;
+	offsets = vec_alloc(sizeof(size_t), 1024);
+	if (NULL == offsets)
+		goto ret_free_chunk;
+
+	while (1) {
+		/* Take previous lines until the chunk is big enough. */
+		for (first = last, len = last_pos; first > 0 && len < chunk_size;)
+			len += line_len(tree_at(file->lines, --first, &hint)) + 1;
+
+		/* Search in joined lines. */
+		ret = file_search_chunk_fill(
+			file, first, 0, last, last_pos, chunk, offsets);
+		if (-1 == ret)
+			break;
+		found = search_bwd(search, vec_items(chunk), vec_len(chunk));
+		offsets_items = vec_items(offsets);
+
+		/* Convert found offset to line and position. */
+		if (NULL != found) {
+			offset = found - (const char *)vec_items(chunk);
+			i = file_search_chunk_line(offsets, offset);
+			*idx = first + i;
+			*pos = offset - offsets_items[i];
+			ret = 1;
+			break;
+		}
+
+		/* Stop at the beginning of file. */
+		ret = 0;
+		if (0 == first)
+			break;
+
+		/* Next chunk overlaps to find occurrences on the edge. */
+		offset = query_len - 1;
+		i = file_search_chunk_line(offsets, offset);
+		last = first + i;
+		last_pos = offset - offsets_items[i];
 	}
 
-	/* Mark file as dirty. */
-	file->is_dirty = 1;
-	return 0;
+	vec_free(offsets);
+ret_free_chunk:
+	vec_free(chunk);
+	return ret;
 }
 
-char
-file_is_dirty(const struct file *const file)
+static int
+file_search_chunks_fwd(
+	const struct file *const file,
+	size_t *const idx,
+	size_t *const pos,
+	const struct search *const search,
+	const size_t query_len)
 {
-	return file->is_dirty;
+	int ret = -1;
+	size_t i;
+	size_t last;
+	size_t len;
+	size_t offset;
+	const char *found;
+	size_t *offsets_items;
+	struct vec *chunk;
+	struct vec *offsets;
+	size_t first = *idx;
+	size_t first_pos = *pos;
+	struct tree_hint hint = {NULL, 0, 0};
+	const size_t lines_cnt = tree_len(file->lines);
+	const size_t chunk_size = MAX(FILE_SEARCH_CHUNK_SIZE, 2 * query_len);
+
+	/* Allocate chunk and offsets of its lines. */
+	chunk = vec_alloc(sizeof(char), chunk_size);
+	if (NULL == chunk)
+		return -1;
+	offsets = vec_alloc(sizeof(size_t), 1024);
+	if (NULL == offsets)
+		goto ret_free_chunk;
+
+	while (1) {
+		/* Take next lines until the chunk is big enough. */
+		last = first;
+		len = line_len(tree_at(file->lines, first, &hint)) - first_pos;
+		while (last + 1 < lines_cnt && len < chunk_size)
+			len += line_len(tree_at(file->lines, ++last, &hint)) + 1;
+
+		/* Search in joined lines. */
+		ret = file_search_chunk_fill(
+			file,
+			first,
+			first_pos,
+			last,
+			line_len(tree_get(file->lines, last)),
+			chunk,
+			offsets
+		);
+		if (-1 == ret)
+			break;
+		found = search_fwd(search, vec_items(chunk), vec_len(chunk));
+		offsets_items = vec_items(offsets);
+
+		/* Convert found offset to line and position. */
+		if (NULL != found) {
+			offset = found - (const char *)vec_items(chunk);
+			i = file_search_chunk_line(offsets, offset);
+			*idx = first + i;
+			*pos = offset - offsets_items[i] + (0 == i ? first_pos : 0);
+			ret = 1;
+			break;
+		}
+
+		/* Stop at the end of file. */
+		ret = 0;
+		if (last + 1 == lines_cnt)
+			break;
+
+		/* Next chunk overlaps to find occurrences on the edge. */
+		offset = vec_len(chunk) - (query_len - 1);
+		i = file_search_chunk_line(offsets, offset);
+		first += i;
+		first_pos = offset - offsets_items[i] + (0 == i ? first_pos : 0);
+	}
+
+	vec_free(offsets);
+ret_free_chunk:
+	vec_free(chunk);
+	return ret;
 }
 
 int
-file_line(
-	const struct file *const file, const size_t idx, struct pub_line *const line)
+file_search_fwd(
+	struct file *const file,
+	size_t *const idx,
+	size_t *const pos,
+	const char *const query)
 {
-	const struct line *internal;
+	int ret;
+	struct line *line;
+	struct search *search;
+	const size_t start_idx = *idx;
+	const size_t start_pos = *pos;
+	const size_t query_len = strlen(query);
 
-	/* Get internal line struct. */
-	internal = vec_get(file->lines, idx);
+	/* Lines are searched contiguous. */
+	file_gap_close(file);
+
+	/* Validate accepted position. */
+	line = tree_get(file->lines, *idx);
 	if (NULL == line)
 		return -1;
+	if (*pos > line_len(line)) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	/* Copy pointers and values to public line. */
-	line->chars = vec_items(internal->chars);
-	line->len = vec_len(internal->chars);
-	line->render = internal->render;
-	line->render_len = internal->render_len;
-	return 0;
+	/* Nothing to search. */
+	if (0 == query_len)
+		return 0;
+
+	/* Compile query once for all lines. */
+	search = search_alloc(query, query_len);
+	if (NULL == search)
+		return -1;
+
+	/* Line breaks are only between lines, so search them in joined lines. */
+	if (NULL == memchr(query, '\n', query_len))
+		ret = file_search_parts(file, idx, pos, search, 1);
+	else
+		ret = file_search_chunks_fwd(file, idx, pos, search, query_len);
+	search_free(search);
+
+	/* Position on the initial line is relative to the initial position. */
+	if (1 == ret && start_idx == *idx)
+		*pos -= start_pos;
+	return ret;
 }
 
-size_t
-file_lines_cnt(const struct file *const file)
+static void
+file_search_part_found(struct file_search_part *const part)
 {
-	return vec_len(file->lines);
+	/* Remember the closest part with result. */
+	pthread_mutex_lock(&part->found->mutex);
+	part->found->num = MIN(part->found->num, part->num);
+	pthread_mutex_unlock(&part->found->mutex);
 }
 
-struct file*
-file_open(const char *const path)
+static char
+file_search_part_is_late(struct file_search_part *const part)
 {
-	int ret;
-	FILE *inner_file;
-	struct file *file;
+	char is_late;
 
-	/* Allocate opaque struct. */
-	file = file_alloc(path);
-	if (NULL == file)
-		return NULL;
+	/* Check that closer part has result. */
+	pthread_mutex_lock(&part->found->mutex);
+	is_late = part->found->num < part->num;
+	pthread_mutex_unlock(&part->found->mutex);
+	return is_late;
+}
 
-	/* Open file using path. */
-	inner_file = fopen(path, "r");
-	if (NULL == inner_file)
-		goto err_free_opaque;
+static void
+file_search_part_run(struct file_search_part *const part)
+{
+	/* Search in the part in its direction. */
+	if (part->is_fwd)
+		part->ret = file_search_runs_fwd(part);
+	else
+		part->ret = file_search_runs_bwd(part);
+}
 
-	/* Read lines. */
-	ret = file_read(file, inner_file);
-	if (-1 == ret)
-		goto err_free_opaque_and_close_file;
+static int
+file_search_parts(
+	struct file *const file,
+	size_t *const idx,
+	size_t *const pos,
+	const struct search *const search,
+	const char is_fwd)
+{
+	int ret;
+	size_t i;
+	size_t cnt;
+	size_t range_len;
+	const struct line *line;
+	struct file_search_part *part;
+	struct file_search_found found;
+	struct file_search_part parts[CFG_SEARCH_THREADS_CNT];
+
+	/* Split lines in search direction to parts if there are many lines. */
+	range_len = is_fwd ? tree_len(file->lines) - *idx : *idx + 1;
+	cnt = MIN(CFG_SEARCH_THREADS_CNT, range_len / FILE_SEARCH_PART_MIN_LINES);
+	cnt = MAX(cnt, 1);
+	for (i = 0; i < cnt; i++) {
+		part = &parts[i];
+		part->file = file;
+		part->search = search;
+		part->is_fwd = is_fwd;
+		part->num = i;
+		part->found = &found;
+		part->ret = 0;
+
+		/* The first part is the closest one to the position. */
+		if (is_fwd) {
+			part->first = *idx + range_len * i / cnt;
+			part->last = *idx + range_len * (i + 1) / cnt - 1;
+			part->idx = part->first;
+			part->pos = 0 == i ? *pos : 0;
+		} else {
+			part->first = *idx + 1 - range_len * (i + 1) / cnt;
+			part->last = *idx - range_len * i / cnt;
+			part->idx = part->last;
+			line = tree_get(file->lines, part->last);
+			part->pos = 0 == i ? *pos : line_len(line);
+		}
+	}
 
-	/* Close opened file. */
-	ret = fclose(inner_file);
-	if (EOF == ret)
-		goto err_free_opaque;
+	/* Initialize state which is shared between parts. */
+	found.num = SIZE_MAX;
+	ret = pthread_mutex_init(&found.mutex, NULL);
+	if (0 != ret) {
+		errno = ret;
+		return -1;
+	}
 
-	/* Add empty line if there is no lines. */
-	if (vec_len(file->lines) == 0) {
-		/* Insert empty line and reset dirty flag. */
-		ret = file_ins_empty_line(file, 0);
-		if (-1 == ret)
-			goto err_free_opaque;
-		file->is_dirty = 0;
+	/* Start threads at the first search of many lines. */
+	if (cnt > 1 && NULL == file->searchers)
+		file->searchers = file_searchers_alloc();
+
+	/* Search in far parts using threads or one by one in this thread. */
+	if (cnt > 1 && NULL != file->searchers) {
+		file_searchers_search(file->searchers, parts, cnt);
+	} else {
+		for (i = 0; i < cnt; i++)
+			file_search_part_run(&parts[i]);
 	}
-	return file;
-err_free_opaque_and_close_file:
-	/* Errors checking is useless here. */
-	fclose(inner_file);
-err_free_opaque:
-	file_free(file);
-	return NULL;
+	pthread_mutex_destroy(&found.mutex);
+
+	/* Take result of the closest part. */
+	for (i = 0; i < cnt; i++) {
+		if (1 == parts[i].ret) {
+			*idx = parts[i].idx;
+			*pos = parts[i].pos;
+			return 1;
+		}
+	}
+	return 0;
 }
 
-const char*
-file_path(const struct file *const file)
+static int
+file_search_runs_bwd(struct file_search_part *const part)
 {
-	return file->path;
+	size_t first;
+	size_t to;
+	const char *begin;
+	const char *found;
+	const struct line *line;
+	size_t last = part->idx;
+	struct tree_hint hint = {NULL, 0, 0};
+	const struct tree *const lines = part->file->lines;
+
+	/* Search in runs which end before the position. */
+	for (to = part->pos;; to = line_len(tree_at(lines, last, &hint))) {
+		/* Stop if closer part already has result. */
+		if (file_search_part_is_late(part))
+			return 0;
+
+		first = file_piece_run_begin(part->file, last, &hint);
+		first = MAX(first, part->first);
+		begin = line_chars(tree_at(lines, first, &hint));
+		line = tree_at(lines, last, &hint);
+		found = search_bwd(part->search, begin, line_chars(line) + to - begin);
+
+		/* Convert found character to line and position. */
+		if (NULL != found) {
+			part->idx = file_piece_run_line(part->file, first, last, found);
+			part->pos = found - line_chars(tree_get(lines, part->idx));
+			file_search_part_found(part);
+			return 1;
+		}
+
+		/* Stop at the beginning of the part. */
+		if (part->first == first)
+			return 0;
+		last = first - 1;
+	}
 }
 
 static int
-file_read(struct file *const file, FILE *const inner)
+file_search_runs_fwd(struct file_search_part *const part)
+{
+	size_t first;
+	size_t last;
+	size_t from;
+	const char *begin;
+	const char *end;
+	const char *found;
+	const struct line *line;
+	struct tree_hint hint = {NULL, 0, 0};
+	const struct tree *const lines = part->file->lines;
+
+	/* Search in runs which begin after the position. */
+	first = part->idx;
+	for (from = part->pos; first <= part->last; first = last + 1, from = 0) {
+		/* Stop if closer part already has result. */
+		if (file_search_part_is_late(part))
+			return 0;
+
+		last = file_piece_run_end(part->file, first, &hint);
+		last = MIN(last, part->last);
+		begin = line_chars(tree_at(lines, first, &hint)) + from;
+		line = tree_at(lines, last, &hint);
+		end = line_chars(line) + line_len(line);
+		found = search_fwd(part->search, begin, end - begin);
+
+		/* Convert found character to line and position. */
+		if (NULL != found) {
+			part->idx = file_piece_run_line(part->file, first, last, found);
+			part->pos = found - line_chars(tree_get(lines, part->idx));
+			file_search_part_found(part);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static struct file_searchers *
+file_searchers_alloc(void)
 {
 	int ret;
-	struct line line;
+	size_t i;
+	struct file_searchers *searchers;
 
-	/* Read lines until EOF. */
-	while (1) {
-		/* Read new line. */
-		ret = line_read(&line, inner);
-		if (1 != ret)
-			return ret;
-
-		/* Append readed line. */
-		ret = vec_append(file->lines, &line, 1);
-		if (-1 == ret) {
-			/* Free line which we can't append. */
-			line_free(&line);
-			return -1;
+	/* Allocate threads' state. */
+	searchers = malloc(sizeof(*searchers));
+	if (NULL == searchers)
+		return NULL;
+
+	/* Initialize synchronization of threads. */
+	ret = pthread_mutex_init(&searchers->mutex, NULL);
+	if (0 != ret)
+		goto err_free;
+	ret = pthread_cond_init(&searchers->work_cond, NULL);
+	if (0 != ret)
+		goto err_destroy_mutex;
+	ret = pthread_cond_init(&searchers->done_cond, NULL);
+	if (0 != ret)
+		goto err_destroy_mutex_and_work_cond;
+	searchers->parts = NULL;
+	searchers->parts_cnt = 0;
+	searchers->next = 0;
+	searchers->done_cnt = 0;
+	searchers->is_stopped = 0;
+
+	/* The calling thread searches too, so one thread less is started. */
+	searchers->threads_cnt = 0;
+	for (i = 1; i < CFG_SEARCH_THREADS_CNT; i++) {
+		ret = pthread_create(
+			&searchers->threads[searchers->threads_cnt],
+			NULL,
+			file_searchers_run,
+			searchers);
+		if (0 != ret)
+			break;
+		searchers->threads_cnt++;
+	}
+	return searchers;
+err_destroy_mutex_and_work_cond:
+	pthread_cond_destroy(&searchers->work_cond);
+err_destroy_mutex:
+	pthread_mutex_destroy(&searchers->mutex);
+err_free:
+	free(searchers);
+	errno = ret;
+	return NULL;
+}
+
+static void
+file_searchers_free(struct file_searchers *const searchers)
+{
+	size_t i;
+
+	/* Wake up waiting threads to exit. */
+	pthread_mutex_lock(&searchers->mutex);
+	searchers->is_stopped = 1;
+	pthread_cond_broadcast(&searchers->work_cond);
+	pthread_mutex_unlock(&searchers->mutex);
+
+	for (i = 0; i < searchers->threads_cnt; i++)
+		pthread_join(searchers->threads[i], NULL);
+	pthread_cond_destroy(&searchers->done_cond);
+	pthread_cond_destroy(&searchers->work_cond);
+	pthread_mutex_destroy(&searchers->mutex);
+	free(searchers);
+}
+
+static void *
+file_searchers_run(void *const arg)
+{
+	struct file_search_part *part;
+	struct file_searchers *const searchers = arg;
+
+	pthread_mutex_lock(&searchers->mutex);
+	while (!searchers->is_stopped) {
+		/* Wait parts of the next search. */
+		if (searchers->next == searchers->parts_cnt) {
+			pthread_cond_wait(&searchers->work_cond, &searchers->mutex);
+			continue;
+		}
+
+		/* Search in the taken part without holding the lock. */
+		part = &searchers->parts[searchers->next++];
+		pthread_mutex_unlock(&searchers->mutex);
+		file_search_part_run(part);
+		pthread_mutex_lock(&searchers->mutex);
+
+		/* Wake up the searching thread if this part is the last one. */
+		searchers->done_cnt++;
+		if (searchers->done_cnt == searchers->parts_cnt)
+			pthread_cond_signal(&searchers->done_cond);
+	}
+	pthread_mutex_unlock(&searchers->mutex);
+	return NULL;
+}
+
+static void
+file_searchers_search(
+	struct file_searchers *const searchers,
+	struct file_search_part *const parts,
+	const size_t cnt)
+{
+	struct file_search_part *part;
+
+	/* Give far parts to the threads. */
+	pthread_mutex_lock(&searchers->mutex);
+	searchers->parts = parts;
+	searchers->parts_cnt = cnt;
+	searchers->next = 1;
+	searchers->done_cnt = 1;
+	pthread_cond_broadcast(&searchers->work_cond);
+	pthread_mutex_unlock(&searchers->mutex);
+
+	/* Search in the closest part in this thread. */
+	file_search_part_run(&parts[0]);
+
+	/* Search in parts which are not taken by threads and wait the others. */
+	pthread_mutex_lock(&searchers->mutex);
+	while (searchers->done_cnt < cnt) {
+		if (searchers->next == cnt) {
+			pthread_cond_wait(&searchers->done_cond, &searchers->mutex);
+			continue;
 		}
+		part = &parts[searchers->next++];
+		pthread_mutex_unlock(&searchers->mutex);
+		file_search_part_run(part);
+		pthread_mutex_lock(&searchers->mutex);
+		searchers->done_cnt++;
 	}
+
+	/* Parts are not valid after the search. */
+	searchers->parts = NULL;
+	searchers->parts_cnt = 0;
+	searchers->next = 0;
+	pthread_mutex_unlock(&searchers->mutex);
+}
+
+static void
+file_stamp(const struct stat *const info, struct undo_stamp *const stamp)
+{
+	stamp->size = info->st_size;
+	stamp->mtime = info->st_mtime;
+	stamp->ino = info->st_ino;
 }
 
-size_t
-file_save(struct file *const file, const char *const custom_path)
+static int
+file_sync_dir(const char *const path)
 {
+	int fd;
 	int ret;
-	FILE *inner;
-	size_t len;
-	const char *const path = NULL == custom_path ? file->path : custom_path;
+	char dir[PATH_MAX];
+	const char *fname;
 
-	/* Try to open file. */
-	inner = fopen(path, "w");
-	if (NULL == inner)
-		return 0;
+	/* Get path of the directory with trailing slash. */
+	fname = strrchr(path, '/');
+	if (NULL == fname)
+		ret = snprintf(dir, sizeof(dir), ".");
+	else
+		ret = snprintf(dir, sizeof(dir), "%.*s", (int)(fname - path + 1), path);
+	if (ret < 0 || (size_t)ret >= sizeof(dir))
+		return -1;
 
-	/* Write lines to opened file. */
-	len = file_write(file, inner);
-	if (0 == len)
-		goto err_close;
+	/* Flush the directory. */
+	fd = open(dir, O_RDONLY);
+	if (-1 == fd)
+		return -1;
+	ret = fsync(fd);
 
-	/* Flush written content. */
-	ret = fflush(inner);
-	if (EOF == ret)
-		goto err_close;
+	/* Errors checking here is useless. */
+	close(fd);
+	return ret;
+}
 
-	/* Close file. */
-	ret = fclose(inner);
-	if (EOF == ret)
-		return 0;
+void
+file_sync_undo(struct file *const file)
+{
+	undo_sync(file->undo);
+}
 
-	/* Remove dirty flag because file was saved. */
-	file->is_dirty = 0;
+static size_t
+file_text_line_len(const char *const text, const size_t len, size_t *const brk)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if ('\n' == text[i]) {
+			*brk = 1;
+			return i;
+		}
+		if ('\r' == text[i]) {
+			/* Windows line break is a single line break. */
+			*brk = i + 1 < len && '\n' == text[i + 1] ? 2 : 1;
+			return i;
+		}
+	}
+	*brk = 0;
 	return len;
-err_close:
-	/* Errors checking here is useless. */
-	fclose(inner);
-	return 0;
 }
 
-size_t
-file_save_to_spare_dir(struct file *const file, char *const path, size_t len)
+int
+file_undo(struct file *const file, size_t *const idx, size_t *const pos)
 {
 	int ret;
-	char date[20];
-	const char *fname;
+	struct undo_rec rec;
 
-	/* Get date and time string. */
-	ret = dt_str(date, sizeof(date));
-	if (-1 == ret)
+	/* Take the last done change. */
+	ret = undo_prev(file->undo, &rec);
+	if (0 == ret)
 		return 0;
 
-	/* Get filename. */
-	fname = basename(file->path);
+	/* Changes are reverted in contiguous lines. */
+	file_gap_close(file);
 
-	/* Build full spare path. */
-	ret = snprintf(path, len, "%s/%s_%s", cfg_spare_save_dir, fname, date);
-	if (ret < 0 || (size_t)ret >= len)
-		return 0;
+	/* Revert the change without journaling. */
+	file->is_journaled = 0;
+	ret = file_revert_rec(file, &rec);
+	file->is_journaled = 1;
+	if (-1 == ret)
+		return -1;
 
-	/* Save file using built path. */
-	return file_save(file, path);
+	/* Return position of the change. */
+	*idx = rec.idx;
+	*pos = rec.pos;
+	return 1;
 }
 
-int
-file_search_bwd(
-	const struct file *const file,
-	size_t *const idx,
-	size_t *const pos,
-	const char *const query)
+static int
+file_undo_dir_open(void)
 {
 	int ret;
-	struct line *line;
-
-	/* Try to get initial line. */
-	line = vec_get(file->lines, *idx);
-	if (NULL == line)
+	int fd;
+	struct stat info;
+	char path[CFG_SPARE_PATH_MAX_LEN + 1];
+	const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+
+	/* Every user has own dir, because spare dir may be shared. */
+	ret = snprintf(
+		path,
+		sizeof(path),
+		"%s/se-%llu",
+		cfg_spare_save_dir,
+		(unsigned long long)getuid());
+	if (ret < 0 || (size_t)ret >= sizeof(path))
+		return -1;
+	ret = mkdir(path, 0700);
+	if (-1 == ret && EEXIST != errno)
 		return -1;
 
-	while (1) {
-		/* Try to search on line if not empty. */
-		if (vec_len(line->chars) > 0) {
-			/* Try to search on line. */
-			ret = line_search_bwd(line, pos, query);
-			/* Return if result found or error happened. */
-			if (ret != 0)
-				return ret;
-		}
-
-		/* Break if the start of file reached. */
-		if (0 == *idx)
-			break;
-
-		/* Move to previous line. */
-		line = vec_get(file->lines, --*idx);
-		if (NULL == line)
-			return -1;
-		/* Continue from the end of previous line. */
-		*pos = vec_len(line->chars);
+	/* Use existing dir only if other users can not change it. */
+	fd = open(path, flags);
+	if (-1 == fd)
+		return -1;
+	ret = fstat(fd, &info);
+	if (-1 == ret || !S_ISDIR(info.st_mode) || !file_undo_is_private(&info)) {
+		/* Errors checking is useless here. */
+		close(fd);
+		return -1;
 	}
-	return 0;
+	return fd;
 }
 
-int
-file_search_fwd(
-	const struct file *const file,
-	size_t *const idx,
-	size_t *const pos,
-	const char *const query)
+static char
+file_undo_is_private(const struct stat *const info)
+{
+	return getuid() == info->st_uid && 0 == (info->st_mode & 077);
+}
+
+static int
+file_undo_name(const struct file *const file, char *const name, const size_t len)
 {
 	int ret;
-	struct line *line;
+	size_t i;
+	char *fname;
+	char real[PATH_MAX];
+	/* FNV-1a hash of the real path. */
+	unsigned long long hash = 14695981039346656037ULL;
 
-	/* Try to get initial line. */
-	line = vec_get(file->lines, *idx);
-	if (NULL == line)
+	/* Hash the real path, so different paths to the file have one journal. */
+	if (NULL == realpath(file->path, real))
 		return -1;
-
-	while (1) {
-		/* Try to search on line if not empty. */
-		if (vec_len(line->chars) > 0) {
-			ret = line_search_fwd(line, pos, query);
-			/* Return if result found or error happened. */
-			if (ret != 0)
-				return ret;
-		}
-
-		/* Break if the end of file reached. */
-		if (*idx + 1 >= vec_len(file->lines))
-			break;
-
-		/* Move to next line. */
-		line = vec_get(file->lines, ++*idx);
-		if (NULL == line)
-			return -1;
-		/* Continue from the beginning of the next line. */
-		*pos = 0;
+	for (i = 0; '\0' != real[i]; i++) {
+		hash ^= (unsigned char)real[i];
+		hash *= 1099511628211ULL;
 	}
+
+	/* Build the name using the file name and the hash. */
+	fname = basename(real);
+	ret = snprintf(name, len + 1, "%s_%016llx.undo", fname, hash);
+	if (ret < 0 || (size_t)ret > len)
+		return -1;
 	return 0;
 }
 
-static size_t
-file_write(const struct file *const file, FILE *const f)
+static int
+file_write_iovs(const int fd, struct iovec *iovs, int cnt)
 {
-	size_t i;
-	size_t ret;
-	size_t len = 0;
-	const struct line *lines;
+	ssize_t ret;
 
-	/* Get lines. */
-	lines = vec_items(file->lines);
+	while (cnt > 0) {
+		/* Write buffers. Retry if interrupted by signal. */
+		ret = writev(fd, iovs, cnt);
+		if (-1 == ret && EINTR == errno)
+			continue;
+		if (-1 == ret)
+			return -1;
 
-	/* Write lines and collect written length. */
-	for (i = 0; i < vec_len(file->lines); i++) {
-		ret = line_write(&lines[i], f);
-		if (0 == ret)
-			return 0;
-		len += ret;
+		/* Skip written buffers. */
+		for (; cnt > 0 && (size_t)ret >= iovs->iov_len; iovs++, cnt--)
+			ret -= iovs->iov_len;
+
+		/* Skip written part of partially written buffer. */
+		if (cnt > 0) {
+			iovs->iov_base = (char *)iovs->iov_base + ret;
+			iovs->iov_len -= ret;
+		}
 	}
-	return len;
+	return 0;
 }
 
 static int
-line_append(struct line *const line, const char *const chars, const size_t len)
+line_append(
+	struct slab *const slab,
+	struct line *const line,
+	const char *const chars,
+	const size_t len)
 {
 	int ret;
 
-	/* Copy chars to line. */
-	ret = vec_append(line->chars, chars, len);
+	/* Move content to own buffer with enough capacity to append. */
+	ret = line_reserve(slab, line, line->len + len);
 	if (-1 == ret)
 		return -1;
 
-	/* Render line with new chars. */
-	ret = line_render(line);
-	return ret;
+	/* Copy chars to line. */
+	memcpy(&line_own_chars(line)[line->len], chars, len);
+	line->len += len;
+
+	/* Appended chars are not rendered. */
+	line_outdate_render(line, line->len - len);
+	return 0;
 }
 
 int
-line_break(struct line *const line, const size_t idx, struct line *const new)
+line_break(
+	struct slab *const slab,
+	struct line *const line,
+	const size_t idx,
+	struct line *const new)
 {
 	int ret;
-	size_t new_len;
-	const char *new_chars;
 
-	/* Initialize new line. */
-	ret = line_init(new);
-	if (-1 == ret)
+	/* Validate break index. */
+	if (idx > line_len(line)) {
+		errno = EINVAL;
 		return -1;
+	}
 
-	/* Get new line length. */
-	new_len = vec_len(line->chars) - idx;
+	/* Break piece into two pieces without copying. */
+	if (0 == line->cap) {
+		*new = *line;
+		new->chars.ptr += idx;
+		new->len -= idx;
+		new->render = NULL;
+		line->len = idx;
+		line_outdate_render(line, idx);
+		return 0;
+	}
 
-	/* Copy characters from broken line to new line if its length is not zero. */
-	if (new_len > 0) {
-		/* Get start of part which we need to move to new line. */
-		new_chars = vec_get(line->chars, idx);
-		if (NULL == new_chars)
-			goto err_free;
+	/* Initialize new line. */
+	line_init(new);
 
+	/* Copy characters from broken line to new line if there are any. */
+	if (line->len > idx) {
 		/* Append broken chars to new line. */
-		ret = line_append(new, new_chars, new_len);
+		ret = line_append(
+			slab, new, &line_chars(line)[idx], line->len - idx);
 		if (-1 == ret)
 			goto err_free;
 
 		/* Cut broken line. */
-		ret = line_cut(line, idx);
+		ret = line_cut(slab, line, idx);
 		if (-1 == ret)
 			goto err_free;
 	}
 	return 0;
 err_free:
-	line_free(new);
+	line_free(slab, new);
 	return -1;
 }
 
 static size_t
-line_calc_render_cap(struct line *const line)
+line_calc_render_len(
+	const struct line *const line, const size_t from, const size_t from_exp)
 {
 	size_t i;
-	size_t len = 0;
+	size_t len = from_exp;
 	const char *chars;
 
-	chars = vec_items(line->chars);
-	for (i = 0; i < vec_len(line->chars); i++)
+	chars = line_chars(line);
+	for (i = from; i < line_len(line); i++)
 		len += str_exp(chars[i], len);
 	return len;
 }
 
+static const char*
+line_chars(const struct line *const line)
+{
+	return LINE_INLINE_CAP == line->cap ? line->chars.buf : line->chars.ptr;
+}
+
+static size_t
+line_col_by_exp(const struct line *const line, const size_t exp)
+{
+	size_t mid;
+	size_t col;
+	size_t col_exp;
+	size_t first = 0;
+	size_t last = line_len(line) / LINE_EXPS_STEP;
+	const size_t *const exps = line->render->exps;
+	const char *const chars = line_chars(line);
+
+	/* Find the last remembered column which is expanded before passed one. */
+	while (first < last) {
+		mid = last - (last - first) / 2;
+		if (exps[mid] < exp)
+			first = mid;
+		else
+			last = mid - 1;
+	}
+
+	/* Expand the following characters until passed column is reached. */
+	col = first * LINE_EXPS_STEP;
+	col_exp = exps[first];
+	while (col < line_len(line) && col_exp < exp)
+		col_exp += str_exp(chars[col++], col_exp);
+	return col;
+}
+
 static int
-line_cut(struct line *const line, const size_t len)
+line_cut(struct slab *const slab, struct line *const line, const size_t len)
 {
 	int ret;
 
 	/* Update broken line's length. */
-	ret = vec_set_len(line->chars, len);
-	if (-1 == ret)
+	if (len > line->len) {
+		errno = EINVAL;
 		return -1;
+	}
+	line->len = len;
 
 	/* Shrink broken line's capacity if needed. */
-	ret = vec_shrink_if_needed(line->chars);
+	ret = line_shrink_if_needed(slab, line);
 	if (-1 == ret)
 		return -1;
 
-	/* Render line with new length. */
-	ret = line_render(line);
-	return ret;
+	/* Cut part of render is outdated. */
+	line_outdate_render(line, len);
+	return 0;
 }
 
-int
-line_del_char(struct line *const line, const size_t idx)
+static int
+line_del(
+	struct slab *const slab,
+	struct line *const line,
+	const size_t idx,
+	const size_t len)
 {
 	int ret;
+	char *chars;
+
+	/* Validate range. */
+	if (idx > line->len || len > line->len - idx) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Move content to own buffer to delete. */
+	ret = line_own(slab, line);
+	if (-1 == ret)
+		return -1;
 
-	/* Remove character. */
-	ret = vec_rm(line->chars, idx, NULL);
+	/* Delete characters and shrink capacity if needed. */
+	chars = line_own_chars(line);
+	memmove(&chars[idx], &chars[idx + len], line->len - idx - len);
+	line->len -= len;
+	ret = line_shrink_if_needed(slab, line);
 	if (-1 == ret)
 		return -1;
 
-	/* Rerender updated line. */
-	ret = line_render(line);
+	/* Render is outdated after deleted characters. */
+	line_outdate_render(line, idx);
+	return 0;
+}
+
+int
+line_del_char(
+	struct slab *const slab, struct line *const line, const size_t idx)
+{
+	int ret;
+
+	/* Delete character from line. */
+	ret = line_del(slab, line, idx, 1);
 	return ret;
 }
 
+static size_t
+line_exp_col(const struct line *const line, const size_t col)
+{
+	size_t i = 0;
+	size_t exp = 0;
+	const char *const chars = line_chars(line);
+	const size_t end = MIN(col, line_len(line));
+
+	/* Start from the closest remembered column which is up to date. */
+	if (NULL != line->render && NULL != line->render->exps) {
+		i = MIN(end, line->render->from) / LINE_EXPS_STEP;
+		exp = line->render->exps[i];
+		i *= LINE_EXPS_STEP;
+	}
+
+	/* Expand the rest of characters. */
+	for (; i < end; i++)
+		exp += str_exp(chars[i], exp);
+	return exp;
+}
+
 void
-line_free(struct line *const line)
+line_free(struct slab *const slab, struct line *const line)
 {
-	/* Free raw chars and render. */
-	vec_free(line->chars);
-	free(line->render);
+	/* Return own raw chars and render to the slab. */
+	if (line->cap > LINE_INLINE_CAP)
+		slab_put(slab, line->chars.ptr, line->cap);
+	if (NULL == line->render)
+		return;
+	if (NULL != line->render->exps)
+		slab_put(
+			slab,
+			line->render->exps,
+			line->render->exps_cap * sizeof(*line->render->exps)
+		);
+	slab_put(slab, line->render, sizeof(struct render) + line->render->cap);
 }
 
-static int
+static void
 line_init(struct line *const line)
 {
-	/* Allocate characters container. */
-	line->chars = vec_alloc(sizeof(char), LINE_CHARS_CAP_STEP);
-	if (NULL == line->chars)
+	/* Empty content fits into the line. */
+	line->len = 0;
+	line->cap = LINE_INLINE_CAP;
+	line->render = NULL;
+}
+
+static int
+line_ins(
+	struct slab *const slab,
+	struct line *const line,
+	const size_t idx,
+	const char *const chars,
+	const size_t len)
+{
+	int ret;
+	char *own;
+
+	/* Validate index. */
+	if (idx > line->len) {
+		errno = EINVAL;
 		return -1;
+	}
 
-	/* Initialize render fields. */
-	line->render = NULL;
-	line->render_len = 0;
+	/* Move content to own buffer with enough capacity to insert. */
+	ret = line_reserve(slab, line, line->len + len);
+	if (-1 == ret)
+		return -1;
+
+	/* Insert characters to line. */
+	own = line_own_chars(line);
+	memmove(&own[idx + len], &own[idx], line->len - idx);
+	memcpy(&own[idx], chars, len);
+	line->len += len;
+
+	/* Render is outdated after inserted characters. */
+	line_outdate_render(line, idx);
 	return 0;
 }
 
 int
-line_ins_char(struct line *const line, const size_t idx, const char ch)
+line_ins_char(
+	struct slab *const slab,
+	struct line *const line,
+	const size_t idx,
+	const char ch)
 {
 	int ret;
 
 	/* Insert character to line. */
-	ret = vec_ins(line->chars, idx, &ch, 1);
-	if (-1 == ret)
-		return -1;
-
-	/* Rerender line after character insertion. */
-	ret = line_render(line);
+	ret = line_ins(slab, line, idx, &ch, 1);
 	return ret;
 }
 
+static size_t
+line_len(const struct line *const line)
+{
+	return line->len;
+}
+
+static void
+line_outdate_render(struct line *const line, const size_t idx)
+{
+	/* Line without render is outdated entirely. */
+	if (NULL != line->render)
+		line->render->from = MIN(line->render->from, idx);
+}
 
 static int
-line_read(struct line *const line, FILE *const f)
+line_own(struct slab *const slab, struct line *const line)
 {
 	int ret;
-	int ch;
-
-	/* Initialize empty line to in which to read. */
-	ret = line_init(line);
-	if (-1 == ret)
-		return -1;
-
-	/* Read characters. */
-	while (1) {
-		/* Try to read character. */
-		ch = fgetc(f);
-		if (ferror(f) != 0)
-			goto err;
-
-		/* First character is EOF. So there is no more lines. */
-		if (vec_len(line->chars) == 0 && EOF == ch) {
-			/* Free unused line. */
-			line_free(line);
-			return 0;
-		}
-
-		/* Check end of line reached. */
-		if ('\n' == ch)
-			break;
 
-		/* Append readed character. */
-		ret = vec_append(line->chars, &ch, 1);
-		if (-1 == ret)
-			goto err;
-	}
+	/* Copy piece's characters to own buffer if line is a piece. */
+	ret = line_reserve(slab, line, line->len);
+	return ret;
+}
 
-	/* Render readed line. */
-	ret = line_render(line);
-	if (-1 == ret)
-		goto err;
-	return 1;
-err:
-	line_free(line);
-	return -1;
+static char*
+line_own_chars(struct line *const line)
+{
+	return LINE_INLINE_CAP == line->cap ? line->chars.buf : line->chars.ptr;
 }
 
 static int
-line_render(struct line *const line)
+line_render(struct slab *const slab, struct line *const line)
 {
-	size_t render_cap;
+	size_t from;
+	size_t from_exp;
+	size_t len;
+	size_t cap;
+	size_t exps_cnt;
+	size_t *exps;
+	struct render *render = line->render;
+	const char *chars;
 
-	/* Free old render. */
-	free(line->render);
-	line->render = NULL;
-	line->render_len = 0;
+	/* Render is up to date. */
+	if (NULL != render && SIZE_MAX == render->from)
+		return 0;
 
-	/* Get new render's capacity. */
-	render_cap = line_calc_render_cap(line);
-	if (0 == render_cap)
+	/* Line without tabs looks as is, so it is not rendered. */
+	chars = line_chars(line);
+	if (NULL == render && NULL == memchr(chars, '\t', line_len(line)))
 		return 0;
 
-	/* Allocate render buffer. */
-	line->render = malloc(render_cap);
-	if (NULL == line->render)
-		return -1;
+	/* Get expanded column of first outdated char. Render before it is valid. */
+	from = NULL == render ? 0 : MIN(render->from, line_len(line));
+	from_exp = line_exp_col(line, from);
+
+	/* Move valid part of render to bigger chunk if new render does not fit. */
+	len = line_calc_render_len(line, from, from_exp);
+	if (NULL == render || len > render->cap) {
+		cap = NULL == render ? len : MAX(len, render->cap * 2);
+		render = slab_take(slab, sizeof(*render) + cap, &cap);
+		if (NULL == render)
+			return -1;
+		render->cap = cap - sizeof(*render);
+		render->from = from;
+		render->exps = NULL;
+		render->exps_cap = 0;
+		if (NULL != line->render) {
+			memcpy(render->chars, line->render->chars, from_exp);
+			render->exps = line->render->exps;
+			render->exps_cap = line->render->exps_cap;
+			slab_put(
+				slab, line->render, sizeof(*render) + line->render->cap);
+		}
+		line->render = render;
+	}
+
+	/* Move valid expanded columns to bigger chunk if all do not fit. */
+	exps_cnt = line_len(line) / LINE_EXPS_STEP + 1;
+	if (exps_cnt > render->exps_cap) {
+		cap = MAX(exps_cnt, render->exps_cap * 2) * sizeof(*exps);
+		exps = slab_take(slab, cap, &cap);
+		if (NULL == exps)
+			return -1;
+		if (NULL != render->exps) {
+			memcpy(
+				exps,
+				render->exps,
+				(from / LINE_EXPS_STEP + 1) * sizeof(*exps)
+			);
+			slab_put(
+				slab, render->exps, render->exps_cap * sizeof(*exps));
+		}
+		render->exps = exps;
+		render->exps_cap = cap / sizeof(*exps);
+	}
 
-	/* Render line after buffer allocation. */
-	line_render_no_alloc(line);
+	/* Render outdated part. */
+	line_render_no_alloc(line, from, from_exp);
+	render->from = SIZE_MAX;
 	return 0;
 }
 
 static void
-line_render_no_alloc(struct line *const line)
+line_render_no_alloc(
+	struct line *const line, const size_t from, const size_t from_exp)
 {
 	size_t i;
 	const char *chars;
-	chars = vec_items(line->chars);
+	struct render *const render = line->render;
+	chars = line_chars(line);
+
+	render->len = from_exp;
+	for (i = from; i < line_len(line); i++) {
+		/* Remember expanded column of every few characters. */
+		if (0 == i % LINE_EXPS_STEP)
+			render->exps[i / LINE_EXPS_STEP] = render->len;
 
-	line->render_len = 0;
-	for (i = 0; i < vec_len(line->chars); i++) {
 		if ('\t' == chars[i]) {
 			/* Expand tab with spaces. */
-			line->render[line->render_len++] = ' ';
-			while (line->render_len % CFG_TAB_SIZE != 0)
-				line->render[line->render_len++] = ' ';
+			render->chars[render->len++] = ' ';
+			while (render->len % CFG_TAB_SIZE != 0)
+				render->chars[render->len++] = ' ';
 		} else {
 			/* Render simple character. */
-			line->render[line->render_len++] = chars[i];
+			render->chars[render->len++] = chars[i];
 		}
 	}
+
+	/* Column after the last character is expanded too. */
+	if (0 == i % LINE_EXPS_STEP)
+		render->exps[i / LINE_EXPS_STEP] = render->len;
 }
 
 static int
-line_search_bwd(
-	const struct line *const line,
-	size_t *const idx,
-	const char *const query
-) {
+line_reserve(struct slab *const slab, struct line *const line, const size_t cap)
+{
 	int ret;
-	const char *start;
-	const char *ptr;
-	size_t query_len;
-
-	/* Validate accepted index. */
-	if (*idx > vec_len(line->chars)) {
-		errno = EINVAL;
-		return -1;
-	}
 
-	/* Validate query length. */
-	query_len = strlen(query);
-	if (0 == query_len)
+	/* Own buffer is already enough. */
+	if (line->cap > 0 && cap <= line->cap)
 		return 0;
 
-	start = vec_items(line->chars);
-
-	for (ptr = start + *idx - query_len; ptr >= start; ptr--) {
-		/* Compare current shifted part with needle. */
-		ret = strncmp(ptr, query, query_len);
-		if (0 == ret) {
-			/* Set result. */
-			*idx = ptr - start;
-			return 1;
-		}
-	}
-	return 0;
+	/* Grow in two times to append fast. */
+	ret = line_resize(slab, line, MAX(cap, line->cap * 2));
+	return ret;
 }
 
 static int
-line_search_fwd(
-	const struct line *const line, size_t *const idx, const char *const query)
+line_resize(struct slab *const slab, struct line *const line, const size_t cap)
 {
-	int ret;
-	size_t search_len;
-	const char *start;
-	const char *ptr;
-	size_t query_len;
-
-	/* Get start of search. */
-	start = vec_get(line->chars, *idx);
-	if (NULL == start)
-		return -1;
-
-	/* Get length of substring. */
-	search_len = vec_len(line->chars) - *idx;
+	char *chars;
+	size_t taken;
 
-	/* Validate query length. */
-	query_len = strlen(query);
-	if (search_len < query_len)
-		return 0;
-	if (0 == query_len)
+	/* Move short content into the line. */
+	if (cap <= LINE_INLINE_CAP) {
+		if (LINE_INLINE_CAP == line->cap)
+			return 0;
+		chars = line->chars.ptr;
+		memcpy(line->chars.buf, chars, line->len);
+		if (line->cap > 0)
+			slab_put(slab, chars, line->cap);
+		line->cap = LINE_INLINE_CAP;
 		return 0;
-
-	for (ptr = start; ptr < start + search_len; ptr++) {
-		/* Compare current shifted part with query. */
-		ret = strncmp(ptr, query, query_len);
-		if (0 == ret) {
-			/* Set result. */
-			*idx = ptr - start;
-			return 1;
-		}
 	}
+
+	/* Copy content to new chunk and return the old one. */
+	chars = slab_take(slab, cap, &taken);
+	if (NULL == chars)
+		return -1;
+	memcpy(chars, line_chars(line), line->len);
+	if (line->cap > LINE_INLINE_CAP)
+		slab_put(slab, line->chars.ptr, line->cap);
+	line->chars.ptr = chars;
+	line->cap = taken;
 	return 0;
 }
 
-static size_t
-line_write(const struct line *const line, FILE *const f)
+static int
+line_shrink_if_needed(struct slab *const slab, struct line *const line)
 {
 	int ret;
-	size_t len;
-	size_t written;
-
-	/* Write line characters to the file. */
-	len = vec_len(line->chars);
-	written = fwrite(vec_items(line->chars), sizeof(char), len, f);
 
-	/* Check write error. */
-	if (written != len)
+	/* Small buffers and buffers with enough content are kept. */
+	if (line->cap <= LINE_SHRINK_MIN_CAP)
 		return 0;
-
-	/* Append newline to the end. */
-	ret = fputc('\n', f);
-	if (EOF == ret)
+	if (line->len >= line->cap / LINE_SHRINK_RATIO)
 		return 0;
 
-	/* Return written length. Do not forget about newline character. */
-	return written + 1;
+	/* Leave space to grow without moving the content back. */
+	ret = line_resize(slab, line, line->len * 2);
+	return ret;
+}
+
+static size_t
+line_weigh(const void *const line)
+{
+	return line_len(line) + 1;
 }
@@ -68,6 +68,16 @@ int file_del_line(struct file *, size_t);
  */
 int file_ins_char(struct file *, size_t, size_t, char);
 
+/*
+ * Inserts text to the file's line at passed position. Text is splitted to
+ * lines by "\n", "\r" or "\r\n".
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if line not found or insertion position is invalid.
+ */
+int file_ins_text(struct file *, size_t, size_t, const char *, size_t);
+
 /*
  * Inserts empty line at index.
  *
@@ -78,28 +88,96 @@ int file_ins_char(struct file *, size_t, size_t, char);
 int file_ins_empty_line(struct file *, size_t);
 
 /*
- * Checks that file is dirty.
+ * Checks that file is dirty. File is dirty until its saving is finished.
  */
 char file_is_dirty(const struct file *);
 
 /*
- * Finds line by passed index and returns its data.
+ * Checks that file is being saved in background.
+ */
+char file_is_saving(const struct file *);
+
+/*
+ * Checks that all changes are synced to the journal file if it is kept.
+ */
+char file_is_undo_synced(const struct file *);
+
+/*
+ * Finds line by passed index and returns its data. Render is not filled, use
+ * `file_line_render` if it is needed. Pointers are valid until the next change
+ * of the file.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int file_line(struct file *, size_t, struct pub_line *);
+
+/*
+ * Finds the first column of the line which is expanded with tabs to at least
+ * passed expanded column. Finds the line's length if there is no such column.
+ * Works for any column in constant time like `file_line_exp_col`.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int file_line_col_by_exp(struct file *, size_t, size_t, size_t *);
+
+/*
+ * Expands passed column of the line with tabs how it looks in the window.
+ * Columns after the line are expanded like the line's length. Render of the
+ * line remembers expanded column of every few characters, so expanding does
+ * not depend on the column.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int file_line_exp_col(struct file *, size_t, size_t, size_t *);
+
+/*
+ * Like `file_line`, but only passed count of the first characters is valid.
+ * The rest of the line being edited is not moved, so getting the head before
+ * the cursor is fast even for long lines.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int file_line_head(struct file *, size_t, size_t, struct pub_line *);
+
+/*
+ * Like `file_line_head`, but also fills render. Render is valid at least for
+ * the head. Only outdated part of the render is updated, so use it for lines
+ * which are drawn.
  *
  * Returns 0 on success and -1 on error.
  *
  * Sets `EINVAL` if index is invalid.
  */
-int file_line(const struct file *, size_t, struct pub_line *);
+int file_line_render(struct file *, size_t, size_t, struct pub_line *);
 
 /*
  * Returns lines count of opened file.
  */
 size_t file_lines_cnt(const struct file *);
 
+/*
+ * Calculates byte offset of passed position on the line by passed index in the
+ * saved file. Position is clamped to the line's length. Index must be valid.
+ *
+ * Returns the offset.
+ */
+size_t file_offset_of(const struct file *, size_t, size_t);
+
 /*
  * Reads the contents of file. Adds an empty line if there are no lines in the
  * file. Do not forget to close file.
  *
+ * The content is read to one buffer and lines refer to it until they are
+ * modified.
+ *
  * Returns pointer to opaque struct on success or `NULL` on error.
  */
 struct file *file_open(const char *);
@@ -109,14 +187,52 @@ struct file *file_open(const char *);
  */
 const char *file_path(const struct file *);
 
+/*
+ * Finds line's index and position on it by passed byte offset in the saved
+ * file. Offset of line break points to the end of its line. Offset is clamped
+ * to the end of the last line.
+ */
+void file_pos_of_offset(const struct file *, size_t, size_t *, size_t *);
+
+/*
+ * Applies the last undone change again. Passed pointers are set to line and
+ * position of the change.
+ *
+ * Returns 1 if change is applied, 0 if there is nothing to redo and -1 on
+ * error.
+ */
+int file_redo(struct file *, size_t *, size_t *);
+
 /*
  * Saves file to passed path. Saves to opened file's path if argument is
- * `NULL`.
+ * `NULL`. Saving to other path keeps the file dirty.
  *
- * Returns written bytes count and 0 on error.
+ * Returns size of the saved file and 0 on error.
  */
 size_t file_save(struct file *, const char *);
 
+/*
+ * Starts saving of the file to its path in other thread. Content is gathered
+ * before return, so further changes are not saved. Check the saving using
+ * `file_save_bg_poll`.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EBUSY` if the file is already being saved.
+ */
+int file_save_bg(struct file *);
+
+/*
+ * Checks the saving in background. Writes saved bytes count and total bytes
+ * count to passed pointers. Only the tail may be written, so the total may be
+ * 0. Finishes the saving if it is done and writes size of the saved file as
+ * the total. Must be called only if the file is being saved.
+ *
+ * Returns 1 if the saving is finished, 0 if it is in progress and -1 if it is
+ * failed.
+ */
+int file_save_bg_poll(struct file *, size_t *, size_t *);
+
 /*
  * Saves file to spare directory with generated path. Useful if no privileges.
  *
@@ -128,21 +244,38 @@ size_t file_save(struct file *, const char *);
 size_t file_save_to_spare_dir(struct file *, char *, size_t);
 
 /*
- * Searches backward from passed position to start of file.
+ * Searches backward from passed position to start of file. Query may contain
+ * line breaks.
  *
  * Returns 1 if result found, 0 if no result and -1 on error.
  *
  * Sets `EINVAL` if index or position is invalid.
  */
-int file_search_bwd(const struct file *, size_t *, size_t *, const char *);
+int file_search_bwd(struct file *, size_t *, size_t *, const char *);
 
 /*
- * Searches forward from passed position to end of file.
+ * Searches forward from passed position to end of file. Query may contain
+ * line breaks.
  *
  * Returns 1 if result found, 0 if no result and -1 on error.
  *
  * Sets `EINVAL` if index or position is invalid.
  */
-int file_search_fwd(const struct file *, size_t *, size_t *, const char *);
+int file_search_fwd(struct file *, size_t *, size_t *, const char *);
+
+/*
+ * Syncs changes to the journal file if it is kept. Syncing may be slow, so call
+ * it when the user is idle.
+ */
+void file_sync_undo(struct file *);
+
+/*
+ * Reverts the last change. Passed pointers are set to line and position of
+ * the change. Sequentially inserted characters are reverted at once.
+ *
+ * Returns 1 if change is reverted, 0 if there is nothing to undo and -1 on
+ * error.
+ */
+int file_undo(struct file *, size_t *, size_t *);
 
 #endif /* _FILE_H */
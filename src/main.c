@@ -1,17 +1,14 @@
 /* TODO: perror errors in goto-cleanups */
 /* TODO: Create Cell struct to handle all symbols including UTF-8. Create structs Win->Renders->Render->Cells->Cell. Rerender lines on window side */
-/* TODO: Use linked list for lines array and line's content parts. */
 /* TODO: Remember last position per line. */
 /* TODO: Open binary files and files with ^M at the end of line. */
-/* TODO: Undo operations. Also rename "del" to "remove" where needed. */
+/* TODO: Rename "del" to "remove" where needed. */
 /* TODO: Add key settings for escape sequences. For example, CFG_KEY_MV_UP_2 = "..." */
 /* TODO: Add local clipboard. Use it in functions. */
 /* TODO: Xclip patch to use with local clipboard. */
-/* TODO: Support huge files: read chunks or try mmap */
 /* TODO: Add tests. */
 /* TODO: Make code patching easier. */
 /* TODO: Add more error codes in docs. */
-/* TODO: Save to spare dir on error. */
 
 #include <signal.h>
 #include <stdio.h>
@@ -73,7 +70,7 @@ edit(const char *const path)
 			goto err_quit;
 		}
 		/* Wait and process key presses. */
-		ret = ed_wait_and_proc_key(ed);
+		ret = ed_wait_and_proc_keys(ed);
 		if (-1 == ret) {
 			err = "Failed to wait and process key";
 			goto err_quit;
@@ -0,0 +1,159 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+
+enum {
+	/* Misses of rare byte candidates before switching to shifts. */
+	SEARCH_RARE_MISSES_CNT = 8,
+};
+
+/*
+ * Compiled query. Search uses `memchr` to find candidates by the rarest byte
+ * of the query and Horspool's shifts if candidates are too frequent.
+ */
+struct search {
+	size_t len; /* Length of the query. */
+	size_t rare_pos; /* Position of the rarest byte of the query. */
+	size_t fwd_shifts[256]; /* Shifts by the last byte of the window. */
+	size_t bwd_shifts[256]; /* Shifts by the first byte of the window. */
+	char query[]; /* Query itself. */
+};
+
+/*
+ * Returns approximate frequency of the byte in texts and source code. Greater
+ * value means more frequent byte.
+ */
+static size_t search_byte_freq(char);
+
+struct search*
+search_alloc(const char *const query, const size_t len)
+{
+	size_t i;
+	size_t freq;
+	size_t rare_freq;
+	struct search *search;
+
+	/* Validate query length. */
+	if (0 == len) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* Allocate opaque struct with the query. */
+	search = malloc(sizeof(*search) + len);
+	if (NULL == search)
+		return NULL;
+	memcpy(search->query, query, len);
+	search->len = len;
+
+	/* Find the rarest byte. */
+	search->rare_pos = 0;
+	rare_freq = search_byte_freq(query[0]);
+	for (i = 1; i < len; i++) {
+		freq = search_byte_freq(query[i]);
+		if (freq < rare_freq) {
+			search->rare_pos = i;
+			rare_freq = freq;
+		}
+	}
+
+	/* Bytes which are not in the query allow to skip the whole window. */
+	for (i = 0; i < 256; i++) {
+		search->fwd_shifts[i] = len;
+		search->bwd_shifts[i] = len;
+	}
+
+	/* Shift to the last occurrence of the byte except the last one. */
+	for (i = 0; i + 1 < len; i++)
+		search->fwd_shifts[(unsigned char)query[i]] = len - 1 - i;
+	/* Shift to the first occurrence of the byte except the first one. */
+	for (i = len - 1; i > 0; i--)
+		search->bwd_shifts[(unsigned char)query[i]] = i;
+	return search;
+}
+
+const char*
+search_bwd(
+	const struct search *const search, const char *const text, const size_t len)
+{
+	size_t i;
+	size_t shift;
+
+	if (len < search->len)
+		return NULL;
+
+	for (i = len - search->len;; i -= shift) {
+		/* Compare window with the query. */
+		if (0 == memcmp(&text[i], search->query, search->len))
+			return &text[i];
+
+		/* Shift window to the left if it does not cross the beginning. */
+		shift = search->bwd_shifts[(unsigned char)text[i]];
+		if (shift > i)
+			return NULL;
+	}
+}
+
+static size_t
+search_byte_freq(const char ch)
+{
+	const char *pos;
+	/* Frequent bytes in descending order. */
+	static const char freqs[] = " etaoinsrhldcumfpgwybvkxjqz\t.,;:_-=()/\"'*"
+		"0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ{}[]<>#&|!?+%@$\\^`~";
+
+	/* Other bytes are rare. Note that null byte is found as terminator. */
+	pos = strchr(freqs, ch);
+	if (NULL == pos || '\0' == ch)
+		return 0;
+	return sizeof(freqs) - (pos - freqs);
+}
+
+void
+search_free(struct search *const search)
+{
+	free(search);
+}
+
+const char*
+search_fwd(
+	const struct search *const search, const char *const text, const size_t len)
+{
+	const char *ptr = text;
+	const char *rare;
+	size_t misses = 0;
+	const char *last;
+	const size_t rare_pos = search->rare_pos;
+	const size_t end_pos = search->len - 1;
+
+	if (len < search->len)
+		return NULL;
+	last = text + len - search->len;
+
+	/* Find candidates using the rarest byte while it is rare in the text. */
+	while (ptr <= last) {
+		rare = memchr(&ptr[rare_pos], search->query[rare_pos], last - ptr + 1);
+		if (NULL == rare)
+			return NULL;
+
+		/* Check the candidate. */
+		ptr = rare - rare_pos;
+		if (0 == memcmp(ptr, search->query, search->len))
+			return ptr;
+		ptr++;
+
+		/* Use shifts if candidates are closer than the query length. */
+		if (++misses <= SEARCH_RARE_MISSES_CNT)
+			continue;
+		if ((size_t)(ptr - text) < misses * search->len)
+			break;
+	}
+
+	for (; ptr <= last; ptr += search->fwd_shifts[(unsigned char)ptr[end_pos]]) {
+		/* Compare window with the query. */
+		if (0 == memcmp(ptr, search->query, search->len))
+			return ptr;
+	}
+	return NULL;
+}
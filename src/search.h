@@ -0,0 +1,37 @@
+#ifndef _SEARCH_H
+#define _SEARCH_H
+
+#include <stddef.h>
+
+/* Opaque precompiled search query. */
+struct search;
+
+/*
+ * Compiles query to search it in many texts. Do not forget to free it.
+ *
+ * Returns pointer to opaque search on success and `NULL` on error.
+ *
+ * Sets `EINVAL` if query is empty.
+ */
+struct search *search_alloc(const char *, size_t);
+
+/*
+ * Searches the last occurrence of the query in the text.
+ *
+ * Returns pointer to the occurrence or `NULL` if there is no occurrence.
+ */
+const char *search_bwd(const struct search *, const char *, size_t);
+
+/*
+ * Frees compiled query.
+ */
+void search_free(struct search *);
+
+/*
+ * Searches the first occurrence of the query in the text.
+ *
+ * Returns pointer to the occurrence or `NULL` if there is no occurrence.
+ */
+const char *search_fwd(const struct search *, const char *, size_t);
+
+#endif /* _SEARCH_H */
@@ -0,0 +1,193 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math.h"
+#include "slab.h"
+
+enum {
+	SLAB_BLOCK_SIZE = 1 << 16, /* Size of memory block divided to chunks. */
+	SLAB_CLASSES_CNT = 9, /* Count of size classes. */
+	SLAB_MIN_CHUNK_SIZE = 16, /* Size of the smallest class. */
+};
+
+/*
+ * Slab allocator. Memory is allocated by big blocks and blocks are divided to
+ * chunks with sizes of power of two classes. Returned chunks are linked in the
+ * free lists of their classes and are reused by the next takings. Blocks are
+ * freed only with the whole slab. Big chunks are allocated separately, but
+ * they are also freed with the slab.
+ */
+struct slab {
+	char *free[SLAB_CLASSES_CNT]; /* Lists of returned chunks by classes. */
+	char *blocks; /* List of allocated blocks. The last block is the first. */
+	size_t used; /* Length of divided part of the last block. */
+	struct slab_big *bigs; /* List of chunks bigger than the biggest class. */
+};
+
+/*
+ * Header of separately allocated big chunk. The chunk follows the header.
+ */
+struct slab_big {
+	struct slab_big *prev;
+	struct slab_big *next;
+};
+
+/* Size of the biggest class. */
+#define SLAB_MAX_CHUNK_SIZE (SLAB_MIN_CHUNK_SIZE << (SLAB_CLASSES_CNT - 1))
+
+/*
+ * Returns index of the smallest class which fits passed size.
+ */
+static size_t slab_class(size_t);
+
+/*
+ * Reads pointer to the next chunk or block of the list from the beginning of
+ * passed one.
+ */
+static char *slab_next(const char *);
+
+/*
+ * Writes pointer to the next chunk or block of the list to the beginning of
+ * passed one.
+ */
+static void slab_set_next(char *, char *);
+
+struct slab*
+slab_alloc(void)
+{
+	struct slab *slab;
+
+	/* Allocate opaque struct. Blocks are allocated on the first taking. */
+	slab = calloc(1, sizeof(*slab));
+	if (NULL == slab)
+		return NULL;
+	slab->used = SLAB_BLOCK_SIZE;
+	return slab;
+}
+
+static size_t
+slab_class(const size_t size)
+{
+	size_t class = 0;
+
+	while ((size_t)SLAB_MIN_CHUNK_SIZE << class < size)
+		class++;
+	return class;
+}
+
+void
+slab_free(struct slab *const slab)
+{
+	char *next;
+	char *block;
+	struct slab_big *big;
+
+	/* Free all blocks with their chunks. */
+	for (block = slab->blocks; NULL != block; block = next) {
+		next = slab_next(block);
+		free(block);
+	}
+
+	/* Free big chunks. */
+	while (NULL != slab->bigs) {
+		big = slab->bigs;
+		slab->bigs = big->next;
+		free(big);
+	}
+	free(slab);
+}
+
+static char*
+slab_next(const char *const item)
+{
+	char *next;
+
+	memcpy(&next, item, sizeof(next));
+	return next;
+}
+
+void
+slab_put(struct slab *const slab, void *const chunk, const size_t cap)
+{
+	size_t class;
+	struct slab_big *big;
+
+	/* Unlink big chunk from the list and free it. */
+	if (cap > SLAB_MAX_CHUNK_SIZE) {
+		big = (struct slab_big *)chunk - 1;
+		if (NULL != big->prev)
+			big->prev->next = big->next;
+		else
+			slab->bigs = big->next;
+		if (NULL != big->next)
+			big->next->prev = big->prev;
+		free(big);
+		return;
+	}
+
+	/* Link chunk to the free list of its class. */
+	class = slab_class(cap);
+	slab_set_next(chunk, slab->free[class]);
+	slab->free[class] = chunk;
+}
+
+static void
+slab_set_next(char *const item, char *const next)
+{
+	memcpy(item, &next, sizeof(next));
+}
+
+void*
+slab_take(struct slab *const slab, const size_t cap, size_t *const taken)
+{
+	char *chunk;
+	char *block;
+	size_t class;
+	size_t size;
+	struct slab_big *big;
+
+	/* Allocate big chunk separately and link it to free with the slab. */
+	if (cap > SLAB_MAX_CHUNK_SIZE) {
+		if (cap > SIZE_MAX - sizeof(*big)) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		big = malloc(sizeof(*big) + cap);
+		if (NULL == big)
+			return NULL;
+		big->prev = NULL;
+		big->next = slab->bigs;
+		if (NULL != slab->bigs)
+			slab->bigs->prev = big;
+		slab->bigs = big;
+		*taken = cap;
+		return big + 1;
+	}
+	class = slab_class(cap);
+	size = (size_t)SLAB_MIN_CHUNK_SIZE << class;
+
+	/* Reuse returned chunk of the class if any. */
+	chunk = slab->free[class];
+	if (NULL != chunk) {
+		slab->free[class] = slab_next(chunk);
+		*taken = size;
+		return chunk;
+	}
+
+	/* Allocate new block if the rest of the last one is too small. */
+	if (SLAB_BLOCK_SIZE - slab->used < size) {
+		block = malloc(SLAB_BLOCK_SIZE);
+		if (NULL == block)
+			return NULL;
+		slab_set_next(block, slab->blocks);
+		slab->blocks = block;
+		/* Pointer to the next block is in the first chunk sized place. */
+		slab->used = SLAB_MIN_CHUNK_SIZE;
+	}
+
+	/* Divide chunk from the last block. */
+	chunk = slab->blocks + slab->used;
+	slab->used += size;
+	*taken = size;
+	return chunk;
+}
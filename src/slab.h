@@ -0,0 +1,37 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include <stddef.h>
+
+/* Opaque allocator of small chunks which are freed all at once. */
+struct slab;
+
+/*
+ * Allocates new slab allocator. Do not forget to free it.
+ *
+ * Returns pointer to opaque slab on success and `NULL` on error.
+ */
+struct slab *slab_alloc(void);
+
+/*
+ * Frees the slab with all its chunks at once. Chunks of the slab must not be
+ * used after it.
+ */
+void slab_free(struct slab *);
+
+/*
+ * Returns chunk to the slab to reuse it. Passed capacity must be equal to the
+ * one written by the taking.
+ */
+void slab_put(struct slab *, void *, size_t);
+
+/*
+ * Takes chunk with at least passed capacity from the slab. Capacity is rounded
+ * up to the size class of the slab. Chunks bigger than the biggest class are
+ * allocated separately. Writes actual capacity of the chunk.
+ *
+ * Returns pointer to the chunk on success and `NULL` on error.
+ */
+void *slab_take(struct slab *, size_t, size_t *);
+
+#endif /* _SLAB_H */
@@ -1,8 +1,14 @@
 #include <errno.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include "term.h"
 
+enum {
+	TERM_IOVS_CNT = 256, /* Max count of parts written by one system call. */
+};
+
 /*
  * Structure for controlling input and output.
  */
@@ -17,6 +23,14 @@ struct {
  */
 static void term_set_raw_mode_params(struct termios *);
 
+/*
+ * Writes all passed parts to the terminal. Parts are changed to skip written
+ * data after partial writes.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int term_writev(struct iovec *, int);
+
 int
 term_deinit(void)
 {
@@ -78,29 +92,139 @@ term_set_raw_mode_params(struct termios *const params)
 	params->c_cc[VMIN] = 1;
 }
 
-size_t
-term_wait_key(char *const seq, const size_t len)
+ssize_t
+term_wait_keys(char *const buf, const size_t len, const int timeout)
 {
+	int ret;
 	ssize_t readed;
-
-	/* Read input up to specified length. */
-	readed = read(term.ifd, seq, len);
-	/*
-	 * We ignore the system call interruption that can occur when the window size
-	 * is changed, for example, in xterm.
-	 */
-	if (-1 == readed && errno != EINTR)
-		return 0;
-	/* It's ok to return signed because of error check before. */
-	return readed;
+	size_t total;
+	struct pollfd pfd;
+
+	/* Wait for input if waiting is limited. */
+	pfd.fd = term.ifd;
+	pfd.events = POLLIN;
+	if (timeout >= 0) {
+		ret = poll(&pfd, 1, timeout);
+		if (0 == ret)
+			return 0;
+		if (-1 == ret)
+			return EINTR == errno ? 0 : -1;
+	}
+
+	/* Wait for input up to specified length. */
+	readed = read(term.ifd, buf, len);
+	if (0 == readed) {
+		/* Input is closed, so there will be no more keys. */
+		errno = EIO;
+		return -1;
+	}
+	if (-1 == readed) {
+		/*
+		 * We ignore the system call interruption that can occur when the window
+		 * size is changed, for example, in xterm.
+		 */
+		if (EINTR == errno)
+			return 0;
+		return -1;
+	}
+	total = readed;
+
+	/* Read input which is already available without waiting. */
+	while (total < len) {
+		ret = poll(&pfd, 1, 0);
+		if (ret <= 0 || !(pfd.revents & POLLIN))
+			break;
+
+		readed = read(term.ifd, &buf[total], len - total);
+		if (readed <= 0)
+			break;
+		total += readed;
+	}
+	return total;
 }
 
-ssize_t
+int
 term_write(const char *const buf, const size_t len)
 {
-	ssize_t written;
+	int ret;
+
+	/* Write buffer as the only part. */
+	ret = term_write_slices(buf, len, NULL, 0);
+	return ret;
+}
+
+int
+term_write_slices(
+	const char *const buf,
+	const size_t len,
+	const struct term_slice *const slices,
+	const size_t slices_cnt)
+{
+	int ret;
+	size_t i;
+	size_t end;
+	size_t at = 0;
+	int cnt = 0;
+	struct iovec iovs[TERM_IOVS_CNT];
+
+	for (i = 0; i <= slices_cnt; i++) {
+		/* Gather the part of buffer before the slice or after the last one. */
+		end = i < slices_cnt ? slices[i].at : len;
+		if (end > at) {
+			iovs[cnt].iov_base = (char *)&buf[at];
+			iovs[cnt++].iov_len = end - at;
+			at = end;
+		}
+
+		/* Gather the slice itself. */
+		if (i < slices_cnt && slices[i].len > 0) {
+			iovs[cnt].iov_base = (char *)slices[i].chars;
+			iovs[cnt++].iov_len = slices[i].len;
+		}
+
+		/* Write gathered parts if the next ones may not fit or at the end. */
+		if (cnt + 2 > TERM_IOVS_CNT || (i == slices_cnt && cnt > 0)) {
+			ret = term_writev(iovs, cnt);
+			if (-1 == ret)
+				return -1;
+			cnt = 0;
+		}
+	}
+	return 0;
+}
 
-	/* Write buffer with accepted length. */
-	written = write(term.ofd, buf, len);
-	return written;
+static int
+term_writev(struct iovec *iovs, int cnt)
+{
+	int ret;
+	ssize_t written;
+	struct pollfd pfd;
+
+	while (cnt > 0) {
+		written = writev(term.ofd, iovs, cnt);
+		if (-1 == written) {
+			/* Retry if writing is interrupted before any data is written. */
+			if (EINTR == errno)
+				continue;
+			if (EAGAIN != errno && EWOULDBLOCK != errno)
+				return -1;
+
+			/* Wait until non-blocking terminal accepts more data. */
+			pfd.fd = term.ofd;
+			pfd.events = POLLOUT;
+			ret = poll(&pfd, 1, -1);
+			if (-1 == ret && EINTR != errno)
+				return -1;
+			continue;
+		}
+
+		/* Skip written parts and written beginning of the next one. */
+		for (; cnt > 0 && (size_t)written >= iovs->iov_len; iovs++, cnt--)
+			written -= iovs->iov_len;
+		if (cnt > 0) {
+			iovs->iov_base = (char *)iovs->iov_base + written;
+			iovs->iov_len -= written;
+		}
+	}
+	return 0;
 }
@@ -4,6 +4,16 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 
+/*
+ * Content which is written to the terminal inside of other buffer without
+ * copying to it.
+ */
+struct term_slice {
+	size_t at; /* Count of the buffer's bytes before the slice. */
+	const char *chars; /* Content of the slice. */
+	size_t len; /* Length of the slice. */
+};
+
 /*
  * Deinitializes initialized terminal.
  *
@@ -27,20 +37,35 @@ int term_get_win_size(struct winsize *);
 int term_init(int, int);
 
 /*
- * Waits for a key press.
+ * Waits for key presses and reads all available input to the passed buffer
+ * up to the passed length. So several keys can be readed at once, for
+ * example, during pasting. Waits up to passed milliseconds or infinitely if
+ * it is negative.
+ *
+ * Returns readed characters count on success, 0 if waiting is interrupted
+ * by a signal or timeout and -1 on error.
  *
- * Key press sometimes consists of several characters. Therefore, the pressed
- * key's characters is written to the passed buffer up to the passed length.
+ * Sets `EIO` if the input is closed.
+ */
+ssize_t term_wait_keys(char *, size_t, int);
+
+/*
+ * Writes passed data to the terminal. Writing is continued after partial
+ * writes until all data is written.
  *
- * Returns readed characters count on success and 0 on error.
+ * Returns 0 on success and -1 on error.
  */
-size_t term_wait_key(char *, size_t);
+int term_write(const char *, size_t);
 
 /*
- * Writes passed data to the terminal in one system call.
+ * Writes passed buffer with passed slices inside it. Slices must be ordered by
+ * their positions. Parts are gathered, so usually all data is written in one
+ * system call. Writing is continued after partial writes until all data is
+ * written.
  *
  * Returns 0 on success and -1 on error.
  */
-ssize_t term_write(const char *, size_t);
+int term_write_slices(
+	const char *, size_t, const struct term_slice *, size_t);
 
 #endif /* _TERM_H */
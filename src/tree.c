@@ -0,0 +1,848 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math.h"
+#include "tree.h"
+
+enum {
+	TREE_JOIN_RATIO = 4, /* Join block with neighbour if it is unused in times. */
+	TREE_LEAF_MIN_CAP = 4, /* Min count of items in leaf. */
+	TREE_LEAF_SIZE = 1 << 13, /* Size of leaf's items in bytes. */
+	TREE_NODE_CAP = 64, /* Max count of node's children. */
+};
+
+/*
+ * B+ tree. Items are stored in order in leaves, and nodes above them keep
+ * counts and weights of their children's subtrees. An item is found by index
+ * descending from the root, and insertions and removals change only leaves
+ * and nodes on the way to the index, so all operations are logarithmic.
+ *
+ * Nodes which may be split by an insertion are allocated before it, so the
+ * insertion does not fail in the middle.
+ */
+struct tree {
+	size_t item_size; /* Size of item. */
+	size_t leaf_cap; /* Max count of items in leaf. */
+	size_t (*weigh)(const void *); /* Calculates weight of item. */
+	void *root; /* Root node or leaf if height is 0. */
+	size_t height; /* Count of node levels above leaves. */
+	size_t len; /* Count of items. */
+	size_t weight; /* Weight of all items. */
+	struct tree_node *spare_nodes; /* Allocated nodes linked by first child. */
+	size_t spare_nodes_cnt; /* Count of allocated nodes. */
+	struct tree_leaf *spare_leaf; /* Allocated leaf or `NULL`. */
+};
+
+/*
+ * Node above leaves. Counts and weights of children are stored in the node,
+ * so child is found without visiting others.
+ */
+struct tree_node {
+	size_t len; /* Count of children. */
+	size_t cnts[TREE_NODE_CAP]; /* Counts of items in children's subtrees. */
+	size_t weights[TREE_NODE_CAP]; /* Weights of children's subtrees. */
+	void *children[TREE_NODE_CAP]; /* Nodes or leaves of the next level. */
+};
+
+/*
+ * Block of items.
+ */
+struct tree_leaf {
+	size_t len; /* Count of items. */
+	char items[]; /* Items aligned as `size_t`. */
+};
+
+/*
+ * Right part of node or leaf which is split by insertion.
+ */
+struct tree_split {
+	void *child; /* New node or leaf or `NULL` if nothing is split. */
+	size_t cnt; /* Count of items in the part. */
+	size_t weight; /* Weight of the part. */
+};
+
+/*
+ * Finds leaf which contains item by passed index. Writes index of the leaf's
+ * first item in the tree.
+ */
+static struct tree_leaf *tree_find(const struct tree *, size_t, size_t *);
+
+/*
+ * Frees node or leaf with all its subtree. Height is 0 for leaf.
+ */
+static void tree_free_node(void *, size_t);
+
+/*
+ * Inserts child after the split one to the node. Splits full node in half.
+ * Full node at the end of the tree is kept full, so appending fills nodes
+ * densely. Writes split right part of the node.
+ */
+static void tree_ins_child(
+	struct tree *, struct tree_node *, size_t, char, const struct tree_split *,
+	struct tree_split *);
+
+/*
+ * Inserts items to the leaf. Count of items must not be greater than capacity
+ * of leaf. Splits the leaf like nodes are split.
+ */
+static void tree_ins_leaf(
+	struct tree *, struct tree_leaf *, size_t, char, const char *, size_t,
+	struct tree_split *);
+
+/*
+ * Inserts items to the subtree of node with passed height. Count of items must
+ * not be greater than capacity of leaf.
+ */
+static void tree_ins_node(
+	struct tree *, void *, size_t, size_t, char, const char *, size_t, size_t,
+	struct tree_split *);
+
+/*
+ * Inserts items which fit one leaf to the tree. Grows the tree if the root is
+ * split. Nodes must be reserved.
+ */
+static void tree_ins_part(struct tree *, size_t, const char *, size_t);
+
+/*
+ * Joins child of node with passed height with its neighbour if the child is
+ * almost empty and they fit one block. Empty subtrees are freed.
+ */
+static void tree_join_child(struct tree *, struct tree_node *, size_t, size_t);
+
+/*
+ * Allocates empty leaf.
+ *
+ * Returns pointer to the leaf on success and `NULL` on error.
+ */
+static struct tree_leaf *tree_leaf_alloc(const struct tree *);
+
+/*
+ * Moves children between nodes or inside one node.
+ */
+static void tree_node_move(
+	struct tree_node *, size_t, struct tree_node *, size_t, size_t);
+
+/*
+ * Allocates nodes and leaf which may be needed to insert items to one leaf.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int tree_reserve(struct tree *);
+
+/*
+ * Removes items of one leaf from the subtree of node with passed height.
+ *
+ * Returns weight of removed items.
+ */
+static size_t tree_rm_node(struct tree *, void *, size_t, size_t, size_t);
+
+/*
+ * Takes reserved node.
+ */
+static struct tree_node *tree_take_node(struct tree *);
+
+/*
+ * Takes reserved leaf.
+ */
+static struct tree_leaf *tree_take_leaf(struct tree *);
+
+/*
+ * Returns sum of weights of passed items.
+ */
+static size_t tree_weigh_items(const struct tree *, const char *, size_t);
+
+struct tree*
+tree_alloc(const size_t item_size, size_t (*const weigh)(const void *))
+{
+	struct tree *tree;
+
+	/* Allocate opaque struct. */
+	tree = calloc(1, sizeof(*tree));
+	if (NULL == tree)
+		return NULL;
+	tree->item_size = item_size;
+	tree->leaf_cap = MAX(TREE_LEAF_SIZE / item_size, TREE_LEAF_MIN_CAP);
+	tree->weigh = weigh;
+
+	/* Empty tree is one empty leaf. */
+	tree->root = tree_leaf_alloc(tree);
+	if (NULL == tree->root) {
+		free(tree);
+		return NULL;
+	}
+	return tree;
+}
+
+void*
+tree_at(
+	const struct tree *const tree,
+	const size_t idx,
+	struct tree_hint *const hint)
+{
+	struct tree_leaf *leaf;
+
+	/* Use leaf of the hint if it contains the item. */
+	if (idx - hint->first < hint->len)
+		return hint->items + (idx - hint->first) * tree->item_size;
+
+	/* Validate index. */
+	if (idx >= tree->len) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* Find leaf and remember it. */
+	leaf = tree_find(tree, idx, &hint->first);
+	hint->items = leaf->items;
+	hint->len = leaf->len;
+	return hint->items + (idx - hint->first) * tree->item_size;
+}
+
+static struct tree_leaf*
+tree_find(const struct tree *const tree, size_t idx, size_t *const first)
+{
+	size_t i;
+	size_t height;
+	struct tree_node *node;
+	void *child = tree->root;
+
+	/* Descend to the child which contains the item on every level. */
+	*first = idx;
+	for (height = tree->height; height > 0; height--) {
+		node = child;
+		for (i = 0; idx >= node->cnts[i]; i++)
+			idx -= node->cnts[i];
+		child = node->children[i];
+	}
+	*first -= idx;
+	return child;
+}
+
+void
+tree_free(struct tree *const tree)
+{
+	struct tree_node *node;
+
+	/* Free all nodes and leaves including reserved ones. */
+	tree_free_node(tree->root, tree->height);
+	while (NULL != tree->spare_nodes) {
+		node = tree->spare_nodes;
+		tree->spare_nodes = node->children[0];
+		free(node);
+	}
+	free(tree->spare_leaf);
+	free(tree);
+}
+
+static void
+tree_free_node(void *const ptr, const size_t height)
+{
+	size_t i;
+	struct tree_node *const node = ptr;
+
+	/* Free children before the node. */
+	if (height > 0) {
+		for (i = 0; i < node->len; i++)
+			tree_free_node(node->children[i], height - 1);
+	}
+	free(ptr);
+}
+
+void*
+tree_get(const struct tree *const tree, const size_t idx)
+{
+	void *item;
+	struct tree_hint hint = {NULL, 0, 0};
+
+	/* Find item without remembering its leaf. */
+	item = tree_at(tree, idx, &hint);
+	return item;
+}
+
+size_t
+tree_idx_of_weight(
+	const struct tree *const tree, size_t weight, size_t *const before)
+{
+	size_t i;
+	size_t height;
+	size_t item_weight;
+	struct tree_node *node;
+	struct tree_leaf *leaf;
+	void *child = tree->root;
+	size_t idx = 0;
+
+	/* Weight is not covered by any item. */
+	if (weight >= tree->weight) {
+		*before = tree->weight;
+		return tree->len;
+	}
+
+	/* Skip children which are covered by the weight. */
+	*before = 0;
+	for (height = tree->height; height > 0; height--) {
+		node = child;
+		for (i = 0; i + 1 < node->len && weight >= node->weights[i]; i++) {
+			weight -= node->weights[i];
+			*before += node->weights[i];
+			idx += node->cnts[i];
+		}
+		child = node->children[i];
+	}
+
+	/* Skip the leaf's items which are covered by the weight. */
+	leaf = child;
+	for (i = 0; i < leaf->len; i++) {
+		item_weight = tree->weigh(&leaf->items[i * tree->item_size]);
+		if (weight < item_weight)
+			break;
+		weight -= item_weight;
+		*before += item_weight;
+	}
+	return idx + i;
+}
+
+int
+tree_ins(
+	struct tree *const tree,
+	const size_t idx,
+	const void *const items,
+	const size_t cnt)
+{
+	int ret;
+	size_t part;
+	size_t done;
+
+	/* Validate index. */
+	if (idx > tree->len) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Insert items by parts which fit one leaf. */
+	for (done = 0; done < cnt; done += part) {
+		part = MIN(cnt - done, tree->leaf_cap);
+		ret = tree_reserve(tree);
+		if (-1 == ret) {
+			/* Remove inserted parts to leave the tree unchanged. */
+			tree_rm_range(tree, idx, done);
+			return -1;
+		}
+		tree_ins_part(
+			tree, idx + done, (const char *)items + done * tree->item_size, part);
+	}
+	return 0;
+}
+
+static void
+tree_ins_child(
+	struct tree *const tree,
+	struct tree_node *const node,
+	const size_t pos,
+	const char is_end,
+	const struct tree_split *const child,
+	struct tree_split *const split)
+{
+	size_t i;
+	size_t left_len;
+	struct tree_node *right;
+
+	/* Insert child if there is space. */
+	split->child = NULL;
+	if (node->len < TREE_NODE_CAP) {
+		tree_node_move(node, pos + 1, node, pos, node->len - pos);
+		node->len++;
+		node->cnts[pos] = child->cnt;
+		node->weights[pos] = child->weight;
+		node->children[pos] = child->child;
+		return;
+	}
+
+	/* Split node, so the new child is either in the left or right part. */
+	right = tree_take_node(tree);
+	left_len = is_end ? TREE_NODE_CAP : (TREE_NODE_CAP + 1) / 2;
+	right->len = TREE_NODE_CAP + 1 - left_len;
+	if (pos < left_len) {
+		tree_node_move(right, 0, node, left_len - 1, right->len);
+		tree_node_move(node, pos + 1, node, pos, left_len - 1 - pos);
+		node->cnts[pos] = child->cnt;
+		node->weights[pos] = child->weight;
+		node->children[pos] = child->child;
+	} else {
+		tree_node_move(right, 0, node, left_len, pos - left_len);
+		tree_node_move(
+			right, pos - left_len + 1, node, pos, TREE_NODE_CAP - pos);
+		right->cnts[pos - left_len] = child->cnt;
+		right->weights[pos - left_len] = child->weight;
+		right->children[pos - left_len] = child->child;
+	}
+	node->len = left_len;
+
+	/* Count the right part for the parent. */
+	split->child = right;
+	split->cnt = 0;
+	split->weight = 0;
+	for (i = 0; i < right->len; i++) {
+		split->cnt += right->cnts[i];
+		split->weight += right->weights[i];
+	}
+}
+
+static void
+tree_ins_leaf(
+	struct tree *const tree,
+	struct tree_leaf *const leaf,
+	const size_t pos,
+	const char is_end,
+	const char *const items,
+	const size_t cnt,
+	struct tree_split *const split)
+{
+	size_t a_len;
+	size_t b_from;
+	size_t b_len;
+	size_t c_from;
+	size_t total;
+	size_t left_len;
+	struct tree_leaf *right;
+	const size_t size = tree->item_size;
+	char *const old = leaf->items;
+
+	/* Insert items if there is space. */
+	split->child = NULL;
+	if (leaf->len + cnt <= tree->leaf_cap) {
+		memmove(
+			&old[(pos + cnt) * size], &old[pos * size], (leaf->len - pos) * size);
+		memcpy(&old[pos * size], items, cnt * size);
+		leaf->len += cnt;
+		return;
+	}
+
+	/*
+	 * Split leaf. Items are the old ones before position, inserted ones and
+	 * the old ones after position. The right part is filled first because
+	 * filling of the left part overwrites old items.
+	 */
+	right = tree_take_leaf(tree);
+	total = leaf->len + cnt;
+	left_len = is_end ? tree->leaf_cap : total / 2;
+	a_len = pos > left_len ? pos - left_len : 0;
+	b_from = MAX(left_len, pos) - pos;
+	b_len = cnt > b_from ? cnt - b_from : 0;
+	c_from = MAX(left_len, pos + cnt) - cnt;
+	memcpy(right->items, &old[(pos - a_len) * size], a_len * size);
+	memcpy(&right->items[a_len * size], &items[b_from * size], b_len * size);
+	memcpy(
+		&right->items[(a_len + b_len) * size],
+		&old[c_from * size],
+		(leaf->len - c_from) * size
+	);
+	if (left_len > pos) {
+		if (left_len > pos + cnt) {
+			memmove(
+				&old[(pos + cnt) * size],
+				&old[pos * size],
+				(left_len - pos - cnt) * size
+			);
+		}
+		memcpy(&old[pos * size], items, MIN(cnt, left_len - pos) * size);
+	}
+	leaf->len = left_len;
+	right->len = total - left_len;
+
+	/* Count the right part for the parent. */
+	split->child = right;
+	split->cnt = right->len;
+	split->weight = tree_weigh_items(tree, right->items, right->len);
+}
+
+static void
+tree_ins_node(
+	struct tree *const tree,
+	void *const ptr,
+	const size_t height,
+	size_t idx,
+	const char is_end,
+	const char *const items,
+	const size_t cnt,
+	const size_t weight,
+	struct tree_split *const split)
+{
+	size_t i;
+	struct tree_split child_split;
+	struct tree_node *const node = ptr;
+
+	if (0 == height) {
+		tree_ins_leaf(tree, ptr, idx, is_end, items, cnt, split);
+		return;
+	}
+
+	/* Find child to insert. Index at the end of child belongs to it. */
+	for (i = 0; i + 1 < node->len && idx > node->cnts[i]; i++)
+		idx -= node->cnts[i];
+
+	/* Insert to the child and add its split part after it. */
+	tree_ins_node(
+		tree,
+		node->children[i],
+		height - 1,
+		idx,
+		is_end,
+		items,
+		cnt,
+		weight,
+		&child_split
+	);
+	node->cnts[i] += cnt;
+	node->weights[i] += weight;
+	split->child = NULL;
+	if (NULL == child_split.child)
+		return;
+	node->cnts[i] -= child_split.cnt;
+	node->weights[i] -= child_split.weight;
+	tree_ins_child(tree, node, i + 1, is_end, &child_split, split);
+}
+
+static void
+tree_ins_part(
+	struct tree *const tree,
+	const size_t idx,
+	const char *const items,
+	const size_t cnt)
+{
+	size_t weight;
+	struct tree_node *root;
+	struct tree_split split;
+
+	/* Insert items on the way from the root. */
+	weight = tree_weigh_items(tree, items, cnt);
+	tree_ins_node(
+		tree,
+		tree->root,
+		tree->height,
+		idx,
+		idx == tree->len,
+		items,
+		cnt,
+		weight,
+		&split
+	);
+
+	/* Add new root above the split one. */
+	if (NULL != split.child) {
+		root = tree_take_node(tree);
+		root->len = 2;
+		root->cnts[0] = tree->len + cnt - split.cnt;
+		root->weights[0] = tree->weight + weight - split.weight;
+		root->children[0] = tree->root;
+		root->cnts[1] = split.cnt;
+		root->weights[1] = split.weight;
+		root->children[1] = split.child;
+		tree->root = root;
+		tree->height++;
+	}
+	tree->len += cnt;
+	tree->weight += weight;
+}
+
+static void
+tree_join_child(
+	struct tree *const tree,
+	struct tree_node *const node,
+	const size_t height,
+	const size_t i)
+{
+	size_t cap;
+	size_t l;
+	size_t l_len;
+	size_t r_len;
+	struct tree_leaf *l_leaf;
+	struct tree_leaf *r_leaf;
+	struct tree_node *l_node;
+	struct tree_node *r_node;
+	const size_t size = tree->item_size;
+
+	/* Child without neighbours is not joined. */
+	if (node->len < 2)
+		return;
+
+	/* Free empty subtree. */
+	if (0 == node->cnts[i]) {
+		tree_free_node(node->children[i], height - 1);
+		tree_node_move(node, i, node, i + 1, node->len - i - 1);
+		node->len--;
+		return;
+	}
+
+	/* Join with the smaller neighbour. */
+	if (0 == i)
+		l = 0;
+	else if (i + 1 == node->len)
+		l = i - 1;
+	else
+		l = node->cnts[i - 1] < node->cnts[i + 1] ? i - 1 : i;
+
+	if (1 == height) {
+		/* Append items of the right leaf to the left one if they fit. */
+		cap = tree->leaf_cap;
+		l_leaf = node->children[l];
+		r_leaf = node->children[l + 1];
+		l_len = l_leaf->len;
+		r_len = r_leaf->len;
+		if (MIN(l_len, r_len) > cap / TREE_JOIN_RATIO || l_len + r_len > cap)
+			return;
+		memcpy(&l_leaf->items[l_len * size], r_leaf->items, r_len * size);
+		l_leaf->len += r_len;
+	} else {
+		/* Append children of the right node to the left one if they fit. */
+		cap = TREE_NODE_CAP;
+		l_node = node->children[l];
+		r_node = node->children[l + 1];
+		l_len = l_node->len;
+		r_len = r_node->len;
+		if (MIN(l_len, r_len) > cap / TREE_JOIN_RATIO || l_len + r_len > cap)
+			return;
+		tree_node_move(l_node, l_len, r_node, 0, r_len);
+		l_node->len += r_len;
+	}
+
+	/* Remove the right child. */
+	node->cnts[l] += node->cnts[l + 1];
+	node->weights[l] += node->weights[l + 1];
+	free(node->children[l + 1]);
+	tree_node_move(node, l + 1, node, l + 2, node->len - l - 2);
+	node->len--;
+}
+
+static struct tree_leaf*
+tree_leaf_alloc(const struct tree *const tree)
+{
+	struct tree_leaf *leaf;
+
+	leaf = malloc(sizeof(*leaf) + tree->leaf_cap * tree->item_size);
+	if (NULL == leaf)
+		return NULL;
+	leaf->len = 0;
+	return leaf;
+}
+
+size_t
+tree_len(const struct tree *const tree)
+{
+	return tree->len;
+}
+
+static void
+tree_node_move(
+	struct tree_node *const dst,
+	const size_t dst_pos,
+	struct tree_node *const src,
+	const size_t src_pos,
+	const size_t cnt)
+{
+	memmove(&dst->cnts[dst_pos], &src->cnts[src_pos], cnt * sizeof(size_t));
+	memmove(
+		&dst->weights[dst_pos], &src->weights[src_pos], cnt * sizeof(size_t));
+	memmove(
+		&dst->children[dst_pos], &src->children[src_pos], cnt * sizeof(void *));
+}
+
+void
+tree_reweigh(struct tree *const tree, size_t idx, const size_t old)
+{
+	size_t i;
+	size_t weight;
+	size_t height;
+	const void *item;
+	struct tree_node *node;
+	void *child = tree->root;
+
+	/* Get new weight of the item. */
+	item = tree_get(tree, idx);
+	if (NULL == item)
+		return;
+	weight = tree->weigh(item);
+
+	/* Replace old weight on the way to the item. */
+	for (height = tree->height; height > 0; height--) {
+		node = child;
+		for (i = 0; idx >= node->cnts[i]; i++)
+			idx -= node->cnts[i];
+		node->weights[i] = node->weights[i] - old + weight;
+		child = node->children[i];
+	}
+	tree->weight = tree->weight - old + weight;
+}
+
+static int
+tree_reserve(struct tree *const tree)
+{
+	struct tree_node *node;
+
+	/* Every level may be split and the root may get a parent. */
+	while (tree->spare_nodes_cnt <= tree->height) {
+		node = malloc(sizeof(*node));
+		if (NULL == node)
+			return -1;
+		node->children[0] = tree->spare_nodes;
+		tree->spare_nodes = node;
+		tree->spare_nodes_cnt++;
+	}
+
+	/* Only one leaf may be split. */
+	if (NULL == tree->spare_leaf) {
+		tree->spare_leaf = tree_leaf_alloc(tree);
+		if (NULL == tree->spare_leaf)
+			return -1;
+	}
+	return 0;
+}
+
+int
+tree_rm(struct tree *const tree, const size_t idx, void *const item)
+{
+	int ret;
+	const void *removed;
+
+	/* Copy item before removing. */
+	if (NULL != item) {
+		removed = tree_get(tree, idx);
+		if (NULL == removed)
+			return -1;
+		memcpy(item, removed, tree->item_size);
+	}
+
+	/* Remove item. */
+	ret = tree_rm_range(tree, idx, 1);
+	return ret;
+}
+
+static size_t
+tree_rm_node(
+	struct tree *const tree,
+	void *const ptr,
+	const size_t height,
+	size_t idx,
+	const size_t cnt)
+{
+	size_t i;
+	size_t weight;
+	struct tree_leaf *leaf;
+	struct tree_node *node;
+	const size_t size = tree->item_size;
+
+	/* Remove items from the leaf. */
+	if (0 == height) {
+		leaf = ptr;
+		weight = tree_weigh_items(tree, &leaf->items[idx * size], cnt);
+		memmove(
+			&leaf->items[idx * size],
+			&leaf->items[(idx + cnt) * size],
+			(leaf->len - idx - cnt) * size
+		);
+		leaf->len -= cnt;
+		return weight;
+	}
+
+	/* Remove from the child which contains the items. */
+	node = ptr;
+	for (i = 0; idx >= node->cnts[i]; i++)
+		idx -= node->cnts[i];
+	weight = tree_rm_node(tree, node->children[i], height - 1, idx, cnt);
+	node->cnts[i] -= cnt;
+	node->weights[i] -= weight;
+
+	/* Do not keep almost empty blocks. */
+	tree_join_child(tree, node, height, i);
+	return weight;
+}
+
+int
+tree_rm_range(struct tree *const tree, size_t idx, size_t cnt)
+{
+	size_t part;
+	size_t first;
+	size_t weight;
+	struct tree_leaf *leaf;
+	struct tree_node *root;
+
+	/* Validate range. */
+	if (idx > tree->len || cnt > tree->len - idx) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Remove items by parts which are in one leaf. */
+	for (; cnt > 0; cnt -= part) {
+		leaf = tree_find(tree, idx, &first);
+		part = MIN(cnt, first + leaf->len - idx);
+		weight = tree_rm_node(tree, tree->root, tree->height, idx, part);
+		tree->len -= part;
+		tree->weight -= weight;
+	}
+
+	/* Lower the tree while the root has the only child. */
+	while (tree->height > 0 && 1 == ((struct tree_node *)tree->root)->len) {
+		root = tree->root;
+		tree->root = root->children[0];
+		tree->height--;
+		free(root);
+	}
+	return 0;
+}
+
+static struct tree_leaf*
+tree_take_leaf(struct tree *const tree)
+{
+	struct tree_leaf *const leaf = tree->spare_leaf;
+
+	tree->spare_leaf = NULL;
+	return leaf;
+}
+
+static struct tree_node*
+tree_take_node(struct tree *const tree)
+{
+	struct tree_node *const node = tree->spare_nodes;
+
+	tree->spare_nodes = node->children[0];
+	tree->spare_nodes_cnt--;
+	return node;
+}
+
+size_t
+tree_weight_before(const struct tree *const tree, size_t idx)
+{
+	size_t i;
+	size_t height;
+	struct tree_node *node;
+	struct tree_leaf *leaf;
+	void *child = tree->root;
+	size_t weight = 0;
+
+	/* Sum weights of children before the way to the index. */
+	for (height = tree->height; height > 0; height--) {
+		node = child;
+		for (i = 0; i + 1 < node->len && idx >= node->cnts[i]; i++) {
+			idx -= node->cnts[i];
+			weight += node->weights[i];
+		}
+		child = node->children[i];
+	}
+
+	/* Sum weights of the leaf's items before the index. */
+	leaf = child;
+	weight += tree_weigh_items(tree, leaf->items, MIN(idx, leaf->len));
+	return weight;
+}
+
+static size_t
+tree_weigh_items(
+	const struct tree *const tree, const char *const items, const size_t cnt)
+{
+	size_t i;
+	size_t weight = 0;
+
+	for (i = 0; i < cnt; i++)
+		weight += tree->weigh(&items[i * tree->item_size]);
+	return weight;
+}
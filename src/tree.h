@@ -0,0 +1,111 @@
+#ifndef _TREE_H
+#define _TREE_H
+
+#include <stddef.h>
+
+/* Opaque balanced tree of items which are stored in blocks. */
+struct tree;
+
+/*
+ * Leaf of the tree which is remembered by the lookup, so neighbour items are
+ * got without descending from the root. Zero it before the first use and
+ * after every change of the tree.
+ */
+struct tree_hint {
+	char *items; /* Items of the leaf. */
+	size_t first; /* Index of the leaf's first item in the tree. */
+	size_t len; /* Count of the leaf's items. */
+};
+
+/*
+ * Allocates new empty tree with passed item size. Items have weights which are
+ * calculated by passed function, so the weight of all items before any index
+ * is known. Do not forget to free it.
+ *
+ * Returns pointer to opaque tree on success and `NULL` on error.
+ */
+struct tree *tree_alloc(size_t, size_t (*)(const void *));
+
+/*
+ * Gets tree's item by index using passed hint. The leaf of the hint is used
+ * if it contains the item, so sequential lookups are fast. Otherwise, the hint
+ * is updated.
+ *
+ * Returns pointer to item on success and `NULL` on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+void *tree_at(const struct tree *, size_t, struct tree_hint *);
+
+/*
+ * Frees the tree with all its blocks.
+ */
+void tree_free(struct tree *);
+
+/*
+ * Gets tree's item by index.
+ *
+ * Returns pointer to item on success and `NULL` on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+void *tree_get(const struct tree *, size_t);
+
+/*
+ * Finds item which covers passed weight, so the weight of items before it is
+ * not greater than passed one and the weight with the item is greater. Writes
+ * the weight of items before it.
+ *
+ * Returns index of the item or count of items if passed weight is not less
+ * than the weight of all items.
+ */
+size_t tree_idx_of_weight(const struct tree *, size_t, size_t *);
+
+/*
+ * Copies items to the tree by passed index. Only blocks on the way to the
+ * index are changed. Pointers to items of the tree are invalid after it.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int tree_ins(struct tree *, size_t, const void *, size_t);
+
+/*
+ * Returns count of items in the tree.
+ */
+size_t tree_len(const struct tree *);
+
+/*
+ * Updates weights after the item by passed index is changed in place. Passed
+ * weight is the weight of the item before the change.
+ */
+void tree_reweigh(struct tree *, size_t, size_t);
+
+/*
+ * Finds and removes item by its index. Copies removed item to passed pointer
+ * if it is not `NULL`. Pointers to items of the tree are invalid after it.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if index is invalid.
+ */
+int tree_rm(struct tree *, size_t, void *);
+
+/*
+ * Removes passed count of items beginning with passed index. Blocks which are
+ * almost empty are joined with their neighbours.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if range is invalid.
+ */
+int tree_rm_range(struct tree *, size_t, size_t);
+
+/*
+ * Returns sum of weights of items before passed index. Index may be equal to
+ * the count of items to get weight of all items.
+ */
+size_t tree_weight_before(const struct tree *, size_t);
+
+#endif /* _TREE_H */
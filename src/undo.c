@@ -0,0 +1,704 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "math.h"
+#include "undo.h"
+
+enum {
+	UNDO_FILE_BUF_SIZE = 1 << 16, /* Size of changes buffered before writing. */
+	UNDO_FILE_COMPACT_RATIO = 4, /* Compact file bigger than journal in times. */
+};
+
+/*
+ * Events in the attached file. Every event is a byte with its type followed by
+ * its data.
+ */
+enum undo_ev {
+	UNDO_EV_NEXT, /* Undone record is applied again. No data. */
+	UNDO_EV_PREV, /* Record is undone. No data. */
+	UNDO_EV_PUSH, /* Record is pushed. Header and characters of the record. */
+	UNDO_EV_SAVE, /* Edited file is saved. State of the edited file. */
+	UNDO_EV_SNAPSHOT, /* Journal is replaced. Lengths and the whole log. */
+};
+
+/*
+ * Size of the record in the log with passed characters length.
+ */
+#define UNDO_REC_SIZE(len) (sizeof(struct undo_hdr) + (len) + sizeof(size_t))
+
+/*
+ * Journal of changes. Records are written one after another in the log. Done
+ * records are at the beginning of the log and undone records follow them.
+ */
+struct undo {
+	char *log; /* Records of changes. Allocated on the first record. */
+	size_t cap; /* Capacity of the log. */
+	size_t len; /* Length of all records in the log. */
+	size_t done_len; /* Length of done records in the log. */
+	char is_sealed; /* If set, then the last record can not be extended. */
+	int fd; /* Attached file to keep the journal between runs or -1. */
+	char *buf; /* Events which are not written to the attached file yet. */
+	size_t buf_len; /* Length of buffered events. */
+	size_t file_len; /* Length of the attached file with buffered events. */
+	char is_synced; /* If set, then all events are synced to the file. */
+};
+
+/* Beginning of the attached file. */
+static const char undo_magic[8] = "seundo1\n";
+
+/*
+ * Header of the record in the log. Characters of the record follow the header
+ * and the size of the record ends it, so the log can be walked backward.
+ */
+struct undo_hdr {
+	size_t idx;
+	size_t pos;
+	size_t len;
+	enum undo_op op;
+};
+
+/*
+ * Closes the attached file and keeps the journal only in memory.
+ */
+static void undo_detach(struct undo *);
+
+/*
+ * Forgets the oldest records to free at least passed size. Also forgets at
+ * least a half of the log, so records are moved rarely.
+ */
+static void undo_drop(struct undo *, size_t);
+
+/*
+ * Extends the last record with inserted characters if they are inserted
+ * right after the record's characters.
+ *
+ * Returns 1 if record is extended and 0 if it can not be extended.
+ */
+static int undo_extend(struct undo *, const struct undo_rec *);
+
+/*
+ * Appends event's data to the attached file using the buffer. Big data is
+ * written directly.
+ */
+static void undo_file_append(struct undo *, const void *, size_t);
+
+/*
+ * Calculates length of the event's data in the mapped file.
+ *
+ * Returns length of the data or `SIZE_MAX` if the event is incomplete or
+ * invalid.
+ */
+static size_t undo_file_data_len(const char *, size_t, enum undo_ev);
+
+/*
+ * Finds the end of the last save event in the mapped file if the save has
+ * passed state of the edited file. Incomplete events at the end are ignored.
+ *
+ * Returns offset after the save event or 0 if there is no such save.
+ */
+static size_t undo_file_find_save(
+	const char *, size_t, const struct undo_stamp *);
+
+/*
+ * Writes buffered events to the attached file.
+ */
+static void undo_file_flush(struct undo *);
+
+/*
+ * Applies events from the mapped file up to passed offset to the journal.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int undo_file_replay(struct undo *, const char *, size_t);
+
+/*
+ * Writes data to the attached file directly. Detaches the file on error.
+ */
+static void undo_file_write(struct undo *, const void *, size_t);
+
+/*
+ * Like `undo_next`, but does not write event to the attached file.
+ */
+static int undo_next_rec(struct undo *, struct undo_rec *);
+
+/*
+ * Like `undo_prev`, but does not write event to the attached file.
+ */
+static int undo_prev_rec(struct undo *, struct undo_rec *);
+
+/*
+ * Like `undo_push`, but does not write event to the attached file.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int undo_push_rec(struct undo *, const struct undo_rec *);
+
+/*
+ * Reads the record which begins at passed offset of the log.
+ *
+ * Returns size of the record.
+ */
+static size_t undo_read(const struct undo *, size_t, struct undo_rec *);
+
+/*
+ * Writes the record at the end of the log. There must be enough space.
+ */
+static void undo_write(struct undo *, const struct undo_rec *);
+
+struct undo*
+undo_alloc(const size_t cap)
+{
+	struct undo *undo;
+
+	/* Allocate opaque struct. Log is allocated on the first record. */
+	undo = malloc(sizeof(*undo));
+	if (NULL == undo)
+		return NULL;
+
+	/* Initialize fields. */
+	undo->log = NULL;
+	undo->cap = cap;
+	undo->len = 0;
+	undo->done_len = 0;
+	undo->is_sealed = 1;
+	undo->fd = -1;
+	undo->buf = NULL;
+	undo->buf_len = 0;
+	undo->file_len = 0;
+	undo->is_synced = 1;
+	return undo;
+}
+
+int
+undo_attach(
+	struct undo *const undo, const int fd, const struct undo_stamp *const stamp)
+{
+	int ret;
+	char *map;
+	struct stat info;
+	size_t end = 0;
+	const char ev = UNDO_EV_SAVE;
+
+	/* Allocate buffer of events. */
+	undo->buf = malloc(UNDO_FILE_BUF_SIZE);
+	if (NULL == undo->buf)
+		goto err_close;
+
+	/* Get size of the file to map it. */
+	ret = fstat(fd, &info);
+	if (-1 == ret)
+		goto err_close;
+
+	/* Restore the journal if the last save has the same edited file. */
+	if ((size_t)info.st_size > sizeof(undo_magic)) {
+		map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (MAP_FAILED == map)
+			goto err_close;
+		end = undo_file_find_save(map, info.st_size, stamp);
+		ret = 0 == end ? 0 : undo_file_replay(undo, map, end);
+		/* Errors checking is useless here. */
+		munmap(map, info.st_size);
+		if (-1 == ret)
+			goto err_clr;
+	}
+
+	/* Forget events after the save. Events are appended after it. */
+	ret = ftruncate(fd, end);
+	if (-1 == ret)
+		goto err_close;
+	undo->fd = fd;
+	undo->file_len = end;
+	if (end > 0)
+		return 1;
+
+	/* Begin new file with the current state of the edited file. */
+	undo_file_append(undo, undo_magic, sizeof(undo_magic));
+	undo_file_append(undo, &ev, sizeof(ev));
+	undo_file_append(undo, stamp, sizeof(*stamp));
+	return 0;
+err_clr:
+	/* Partially restored journal does not match the edited file. */
+	undo->len = 0;
+	undo->done_len = 0;
+err_close:
+	/* Errors checking is useless here. */
+	close(fd);
+	return -1;
+}
+
+static void
+undo_detach(struct undo *const undo)
+{
+	/* Errors checking is useless here. */
+	close(undo->fd);
+	undo->fd = -1;
+	undo->buf_len = 0;
+}
+
+static void
+undo_drop(struct undo *const undo, size_t size)
+{
+	size_t rec_size;
+	size_t dropped = 0;
+	struct undo_hdr hdr;
+
+	/* Find the first record which is not dropped. */
+	size = MAX(size, undo->len / 2);
+	while (dropped < size && dropped < undo->len) {
+		memcpy(&hdr, &undo->log[dropped], sizeof(hdr));
+		rec_size = UNDO_REC_SIZE(hdr.len);
+		dropped += rec_size;
+
+		/* Undone records are forgotten before, so done ones are dropped. */
+		undo->done_len -= rec_size;
+	}
+
+	/* Move left records to the beginning of the log. */
+	undo->len -= dropped;
+	memmove(undo->log, &undo->log[dropped], undo->len);
+}
+
+static int
+undo_extend(struct undo *const undo, const struct undo_rec *const rec)
+{
+	size_t size;
+	size_t begin;
+	struct undo_hdr hdr;
+
+	/* Only inserted characters may extend the last record. */
+	if (undo->is_sealed || UNDO_OP_INS_CHARS != rec->op)
+		return 0;
+	if (undo->len + rec->len > undo->cap)
+		return 0;
+
+	/* Read header of the last record. */
+	memcpy(&size, &undo->log[undo->len - sizeof(size)], sizeof(size));
+	begin = undo->len - size;
+	memcpy(&hdr, &undo->log[begin], sizeof(hdr));
+
+	/* Check that characters are inserted right after the record's ones. */
+	if (UNDO_OP_INS_CHARS != hdr.op || hdr.idx != rec->idx)
+		return 0;
+	if (hdr.pos + hdr.len != rec->pos)
+		return 0;
+
+	/* Write characters over the size of the record and write new size. */
+	memcpy(&undo->log[undo->len - sizeof(size)], rec->chars, rec->len);
+	hdr.len += rec->len;
+	memcpy(&undo->log[begin], &hdr, sizeof(hdr));
+	size = UNDO_REC_SIZE(hdr.len);
+	memcpy(&undo->log[begin + size - sizeof(size)], &size, sizeof(size));
+	undo->len = begin + size;
+	undo->done_len = undo->len;
+	return 1;
+}
+
+static void
+undo_file_append(struct undo *const undo, const void *const data, size_t len)
+{
+	/* Write buffered events if there is no space for data. */
+	if (undo->buf_len + len > UNDO_FILE_BUF_SIZE)
+		undo_file_flush(undo);
+	if (-1 == undo->fd)
+		return;
+	undo->is_synced = 0;
+
+	/* Write big data directly. */
+	if (len > UNDO_FILE_BUF_SIZE) {
+		undo_file_write(undo, data, len);
+		return;
+	}
+
+	/* Buffer data. */
+	memcpy(&undo->buf[undo->buf_len], data, len);
+	undo->buf_len += len;
+	undo->file_len += len;
+}
+
+static size_t
+undo_file_data_len(const char *const data, const size_t len, enum undo_ev ev)
+{
+	struct undo_hdr hdr;
+	size_t lens[2];
+
+	switch (ev) {
+	case UNDO_EV_NEXT: /* FALLTHROUGH. */
+	case UNDO_EV_PREV:
+		return 0;
+	case UNDO_EV_PUSH:
+		/* Header is followed by characters. */
+		if (len < sizeof(hdr))
+			return SIZE_MAX;
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr.len > len - sizeof(hdr))
+			return SIZE_MAX;
+		return sizeof(hdr) + hdr.len;
+	case UNDO_EV_SAVE:
+		return len < sizeof(struct undo_stamp) ? SIZE_MAX
+			: sizeof(struct undo_stamp);
+	case UNDO_EV_SNAPSHOT:
+		/* Lengths of the log and done records are followed by the log. */
+		if (len < sizeof(lens))
+			return SIZE_MAX;
+		memcpy(lens, data, sizeof(lens));
+		if (lens[0] > len - sizeof(lens) || lens[1] > lens[0])
+			return SIZE_MAX;
+		return sizeof(lens) + lens[0];
+	}
+	return SIZE_MAX;
+}
+
+static size_t
+undo_file_find_save(
+	const char *const map, const size_t len, const struct undo_stamp *const stamp)
+{
+	size_t i;
+	size_t data_len;
+	size_t end = 0;
+	struct undo_stamp saved;
+
+	/* Check that file is the journal. */
+	if (0 != memcmp(map, undo_magic, sizeof(undo_magic)))
+		return 0;
+
+	/* Walk events until the end or incomplete event. */
+	for (i = sizeof(undo_magic); i < len; i += 1 + data_len) {
+		data_len = undo_file_data_len(&map[i + 1], len - i - 1, map[i]);
+		if (SIZE_MAX == data_len)
+			break;
+
+		/* Remember the last save. */
+		if (UNDO_EV_SAVE == map[i]) {
+			memcpy(&saved, &map[i + 1], sizeof(saved));
+			end = i + 1 + data_len;
+		}
+	}
+
+	/* Check that the edited file is not changed after the last save. */
+	if (0 == end || saved.size != stamp->size || saved.mtime != stamp->mtime)
+		return 0;
+	if (saved.ino != stamp->ino)
+		return 0;
+	return end;
+}
+
+static void
+undo_file_flush(struct undo *const undo)
+{
+	/* Nothing to write. */
+	if (-1 == undo->fd || 0 == undo->buf_len)
+		return;
+
+	/* Write buffered events at once. */
+	undo->file_len -= undo->buf_len;
+	undo_file_write(undo, undo->buf, undo->buf_len);
+	undo->buf_len = 0;
+}
+
+static int
+undo_file_replay(struct undo *const undo, const char *const map, const size_t end)
+{
+	int ret = 0;
+	size_t i;
+	size_t data_len;
+	size_t lens[2];
+	struct undo_hdr hdr;
+	struct undo_rec rec;
+
+	/* Events before the end are already validated. */
+	for (i = sizeof(undo_magic); i < end; i += 1 + data_len) {
+		data_len = undo_file_data_len(&map[i + 1], end - i - 1, map[i]);
+
+		switch (map[i]) {
+		case UNDO_EV_NEXT:
+			undo_next_rec(undo, &rec);
+			break;
+		case UNDO_EV_PREV:
+			undo_prev_rec(undo, &rec);
+			break;
+		case UNDO_EV_PUSH:
+			memcpy(&hdr, &map[i + 1], sizeof(hdr));
+			rec.op = hdr.op;
+			rec.idx = hdr.idx;
+			rec.pos = hdr.pos;
+			rec.chars = &map[i + 1 + sizeof(hdr)];
+			rec.len = hdr.len;
+			ret = undo_push_rec(undo, &rec);
+			break;
+		case UNDO_EV_SNAPSHOT:
+			/* Log is empty if it does not fit the journal anymore. */
+			memcpy(lens, &map[i + 1], sizeof(lens));
+			undo->len = 0;
+			undo->done_len = 0;
+			undo->is_sealed = 1;
+			if (0 == lens[0] || lens[0] > undo->cap)
+				break;
+			if (NULL == undo->log) {
+				undo->log = malloc(undo->cap);
+				if (NULL == undo->log)
+					return -1;
+			}
+			memcpy(undo->log, &map[i + 1 + sizeof(lens)], lens[0]);
+			undo->len = lens[0];
+			undo->done_len = lens[1];
+			break;
+		}
+		if (-1 == ret)
+			return -1;
+	}
+
+	/* Do not extend records restored from the file. */
+	undo->is_sealed = 1;
+	return 0;
+}
+
+static void
+undo_file_write(struct undo *const undo, const void *const data, size_t len)
+{
+	ssize_t written;
+	const char *ptr = data;
+
+	/* Write data until the end. Interrupted writing is continued. */
+	while (len > 0) {
+		written = write(undo->fd, ptr, len);
+		if (-1 == written && EINTR == errno)
+			continue;
+		if (-1 == written) {
+			undo_detach(undo);
+			return;
+		}
+		ptr += written;
+		len -= written;
+		undo->file_len += written;
+	}
+}
+
+void
+undo_free(struct undo *const undo)
+{
+	if (-1 != undo->fd)
+		/* Errors checking is useless here. */
+		close(undo->fd);
+	free(undo->buf);
+	free(undo->log);
+	free(undo);
+}
+
+char
+undo_is_synced(const struct undo *const undo)
+{
+	return -1 == undo->fd || undo->is_synced;
+}
+
+void
+undo_mark_saved(struct undo *const undo, const struct undo_stamp *const stamp)
+{
+	int ret;
+	char ev;
+	size_t lens[2];
+
+	/* Nothing to mark without the attached file. */
+	if (-1 == undo->fd)
+		return;
+
+	/* Replace events with the snapshot of the journal if file is too big. */
+	if (undo->file_len > UNDO_FILE_COMPACT_RATIO * undo->cap) {
+		ret = ftruncate(undo->fd, sizeof(undo_magic));
+		if (-1 == ret) {
+			undo_detach(undo);
+			return;
+		}
+		undo->buf_len = 0;
+		undo->file_len = sizeof(undo_magic);
+
+		ev = UNDO_EV_SNAPSHOT;
+		lens[0] = undo->len;
+		lens[1] = undo->done_len;
+		undo_file_append(undo, &ev, sizeof(ev));
+		undo_file_append(undo, lens, sizeof(lens));
+		undo_file_append(undo, undo->log, undo->len);
+	}
+
+	/* Append the save, write buffered events and sync them. */
+	ev = UNDO_EV_SAVE;
+	undo_file_append(undo, &ev, sizeof(ev));
+	undo_file_append(undo, stamp, sizeof(*stamp));
+	undo_sync(undo);
+}
+
+int
+undo_next(struct undo *const undo, struct undo_rec *const rec)
+{
+	int ret;
+	const char ev = UNDO_EV_NEXT;
+
+	/* Take the record and remember it in the attached file. */
+	ret = undo_next_rec(undo, rec);
+	if (1 == ret && -1 != undo->fd)
+		undo_file_append(undo, &ev, sizeof(ev));
+	return ret;
+}
+
+static int
+undo_next_rec(struct undo *const undo, struct undo_rec *const rec)
+{
+	/* Check that there is nothing to redo. */
+	if (undo->done_len == undo->len)
+		return 0;
+
+	/* Take the first undone record. */
+	undo->done_len += undo_read(undo, undo->done_len, rec);
+	undo->is_sealed = 1;
+	return 1;
+}
+
+int
+undo_prev(struct undo *const undo, struct undo_rec *const rec)
+{
+	int ret;
+	const char ev = UNDO_EV_PREV;
+
+	/* Take the record and remember it in the attached file. */
+	ret = undo_prev_rec(undo, rec);
+	if (1 == ret && -1 != undo->fd)
+		undo_file_append(undo, &ev, sizeof(ev));
+	return ret;
+}
+
+static int
+undo_prev_rec(struct undo *const undo, struct undo_rec *const rec)
+{
+	size_t size;
+
+	/* Check that there is nothing to undo. */
+	if (0 == undo->done_len)
+		return 0;
+
+	/* Take the last done record using its size at the end. */
+	memcpy(&size, &undo->log[undo->done_len - sizeof(size)], sizeof(size));
+	undo->done_len -= size;
+	undo_read(undo, undo->done_len, rec);
+	undo->is_sealed = 1;
+	return 1;
+}
+
+int
+undo_push(struct undo *const undo, const struct undo_rec *const rec)
+{
+	int ret;
+	struct undo_hdr hdr;
+	const char ev = UNDO_EV_PUSH;
+
+	/* Push the record. */
+	ret = undo_push_rec(undo, rec);
+	if (-1 == ret || -1 == undo->fd)
+		return ret;
+
+	/* Remember the record in the attached file. */
+	hdr.idx = rec->idx;
+	hdr.pos = rec->pos;
+	hdr.len = rec->len;
+	hdr.op = rec->op;
+	undo_file_append(undo, &ev, sizeof(ev));
+	undo_file_append(undo, &hdr, sizeof(hdr));
+	if (rec->len > 0)
+		undo_file_append(undo, rec->chars, rec->len);
+	return 0;
+}
+
+static int
+undo_push_rec(struct undo *const undo, const struct undo_rec *const rec)
+{
+	int ret;
+	const size_t size = UNDO_REC_SIZE(rec->len);
+
+	/* Forget undone records. */
+	undo->len = undo->done_len;
+
+	/* Try to extend the last record. */
+	ret = undo_extend(undo, rec);
+	if (1 == ret)
+		return 0;
+
+	/* Forget the whole history if the record does not fit the log. */
+	if (size > undo->cap) {
+		undo->len = 0;
+		undo->done_len = 0;
+		undo->is_sealed = 1;
+		return 0;
+	}
+
+	/* Allocate the log once for all records. */
+	if (NULL == undo->log) {
+		undo->log = malloc(undo->cap);
+		if (NULL == undo->log)
+			return -1;
+	}
+
+	/* Free space for the record and write it. */
+	if (undo->len + size > undo->cap)
+		undo_drop(undo, undo->len + size - undo->cap);
+	undo_write(undo, rec);
+	return 0;
+}
+
+static size_t
+undo_read(
+	const struct undo *const undo, const size_t offset, struct undo_rec *const rec)
+{
+	struct undo_hdr hdr;
+
+	/* Copy header because the log is not aligned. */
+	memcpy(&hdr, &undo->log[offset], sizeof(hdr));
+	rec->op = hdr.op;
+	rec->idx = hdr.idx;
+	rec->pos = hdr.pos;
+	rec->chars = &undo->log[offset + sizeof(hdr)];
+	rec->len = hdr.len;
+	return UNDO_REC_SIZE(hdr.len);
+}
+
+void
+undo_sync(struct undo *const undo)
+{
+	int ret;
+
+	/* Nothing to sync. */
+	if (undo_is_synced(undo))
+		return;
+
+	/* Write buffered events and sync them. */
+	undo_file_flush(undo);
+	if (-1 == undo->fd)
+		return;
+	ret = fdatasync(undo->fd);
+	if (-1 == ret) {
+		undo_detach(undo);
+		return;
+	}
+	undo->is_synced = 1;
+}
+
+static void
+undo_write(struct undo *const undo, const struct undo_rec *const rec)
+{
+	struct undo_hdr hdr;
+	const size_t size = UNDO_REC_SIZE(rec->len);
+
+	/* Write header, characters and size of the record. */
+	hdr.idx = rec->idx;
+	hdr.pos = rec->pos;
+	hdr.len = rec->len;
+	hdr.op = rec->op;
+	memcpy(&undo->log[undo->len], &hdr, sizeof(hdr));
+	/* Records of line operations have no characters, so they are `NULL`. */
+	if (rec->len > 0)
+		memcpy(&undo->log[undo->len + sizeof(hdr)], rec->chars, rec->len);
+	memcpy(&undo->log[undo->len + size - sizeof(size)], &size, sizeof(size));
+	undo->len += size;
+	undo->done_len = undo->len;
+	undo->is_sealed = 0;
+}
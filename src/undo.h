@@ -0,0 +1,118 @@
+#ifndef _UNDO_H
+#define _UNDO_H
+
+#include <stddef.h>
+
+/* Opaque journal of changes. */
+struct undo;
+
+/*
+ * Operations which change the file.
+ */
+enum undo_op {
+	UNDO_OP_ABSORB_NEXT_LINE, /* Next line is appended at the position. */
+	UNDO_OP_BREAK_LINE, /* Line is broken at the position. */
+	UNDO_OP_DEL_CHAR, /* Character is deleted at the position. */
+	UNDO_OP_DEL_LINE, /* Line with characters is deleted. */
+	UNDO_OP_INS_CHARS, /* Characters are inserted at the position. */
+	UNDO_OP_INS_EMPTY_LINE, /* Empty line is inserted. */
+	UNDO_OP_INS_TEXT, /* Text with line breaks is inserted at the position. */
+};
+
+/*
+ * State of the edited file on disk. Journal from the file is restored only
+ * if the edited file has the same state as after the last save.
+ */
+struct undo_stamp {
+	unsigned long long size;
+	long long mtime;
+	unsigned long long ino;
+};
+
+/*
+ * Record of one change. Characters are deleted ones for deleting operations
+ * and inserted ones for inserting operations.
+ */
+struct undo_rec {
+	enum undo_op op;
+	size_t idx; /* Index of changed line. */
+	size_t pos; /* Position in changed line. */
+	const char *chars;
+	size_t len;
+};
+
+/*
+ * Allocates empty journal which keeps records up to passed size in bytes.
+ * Memory for records is allocated once on the first record. Do not forget to
+ * free it.
+ *
+ * Returns pointer to opaque journal on success and `NULL` on error.
+ */
+struct undo *undo_alloc(size_t);
+
+/*
+ * Attaches file descriptor to keep the journal between runs. The journal is
+ * restored from the file if the last save in it has passed state of the
+ * edited file. Otherwise, the file is cleared. Then changes are appended to
+ * the file. The descriptor is closed on freeing.
+ *
+ * Changes are buffered and the file is synced when the edited file is saved
+ * or on `undo_sync`. If writing to the file fails, the file is detached and
+ * the journal is kept only in memory.
+ *
+ * Returns 1 if the journal is restored, 0 if the file is cleared and -1 on
+ * error. The descriptor is closed on error.
+ */
+int undo_attach(struct undo *, int, const struct undo_stamp *);
+
+/*
+ * Frees the journal.
+ */
+void undo_free(struct undo *);
+
+/*
+ * Checks that all changes are synced to the attached file. Always set if there
+ * is no attached file.
+ */
+char undo_is_synced(const struct undo *);
+
+/*
+ * Remembers that the edited file is saved with passed state. Writes buffered
+ * changes and syncs the attached file. Does nothing if there is no attached
+ * file.
+ */
+void undo_mark_saved(struct undo *, const struct undo_stamp *);
+
+/*
+ * Takes the next undone record to apply it again. Characters of the record
+ * are valid until the next push.
+ *
+ * Returns 1 if there is the record and 0 if there is nothing to redo.
+ */
+int undo_next(struct undo *, struct undo_rec *);
+
+/*
+ * Takes the last done record to revert it. Characters of the record are valid
+ * until the next push.
+ *
+ * Returns 1 if there is the record and 0 if there is nothing to undo.
+ */
+int undo_prev(struct undo *, struct undo_rec *);
+
+/*
+ * Writes record to the journal and forgets undone records. Characters which
+ * are inserted right after the last inserted ones extend the last record.
+ * The oldest records are forgotten if there is no space for the new one. The
+ * whole history is forgotten if the record is greater than the journal.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int undo_push(struct undo *, const struct undo_rec *);
+
+/*
+ * Writes buffered changes and syncs the attached file. Syncing may be slow, so
+ * call it when the user is idle. Does nothing if changes are already synced.
+ */
+void undo_sync(struct undo *);
+
+#endif /* _UNDO_H */
@@ -7,15 +7,24 @@
 #include "math.h"
 #include "vec.h"
 
+enum {
+	VEC_GROW_DIV = 2, /* Capacity grows by its part, so by a half. */
+	VEC_MAX_GROW_SIZE = 1 << 26, /* Max size of growing step in bytes. */
+	VEC_SHRINK_RATIO = 4, /* Shrink if capacity is unused in times. */
+};
+
 /*
- * Dynamic vector with capacity reallocation step.
+ * Dynamic vector. Capacity grows geometrically from the minimal step, so
+ * appending is amortized constant. Capacity shrinks only if most of it is
+ * unused and keeps space to grow, so alternating insertions and removals do
+ * not reallocate.
  */
 struct vec {
 	char *items; /* Pointer to the beginning of dynamic array with items . */
 	size_t item_size; /* Size of item in dynamic array. */
 	size_t len; /* Length of dynamic array. */
 	size_t cap; /* Capacity of dynamic array. */
-	size_t cap_step; /* Step of growing and shrinking of dynamic array. */
+	size_t cap_step; /* Min step of growing and shrinking of dynamic array. */
 };
 
 /*
@@ -101,14 +110,16 @@ static int
 vec_grow_if_needed(struct vec *const vec, const size_t new_len)
 {
 	int ret;
+	size_t step;
 	size_t new_cap;
 
 	/* No need to grow. */
 	if (new_len <= vec->cap)
 		return 0;
 
-	/* Get optimal new capacity. */
-	new_cap = MAX(vec->cap + vec->cap_step, new_len);
+	/* Grow by a part of capacity, but not too much for huge vectors. */
+	step = MIN(vec->cap / VEC_GROW_DIV, VEC_MAX_GROW_SIZE / vec->item_size);
+	new_cap = MAX(vec->cap + MAX(step, vec->cap_step), new_len);
 
 	/* Grow with new capacity. */
 	ret = vec_realloc(vec, new_cap);
@@ -210,10 +221,35 @@ vec_len(const struct vec *const vec)
 static int
 vec_realloc(struct vec *const vec, const size_t new_cap)
 {
-	/* Reallocate items and update the capacity. */
+	char *items;
+
+	/* Validate new size. */
+	if (new_cap > SIZE_MAX / vec->item_size) {
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* Reallocate items and update the capacity. Items are kept on error. */
+	items = realloc(vec->items, new_cap * vec->item_size);
+	if (NULL == items)
+		return -1;
+	vec->items = items;
 	vec->cap = new_cap;
-	vec->items = realloc(vec->items, new_cap * vec->item_size);
-	return NULL == vec->items ? -1 : 0;
+	return 0;
+}
+
+int
+vec_reserve(struct vec *const vec, const size_t cap)
+{
+	int ret;
+
+	/* No need to grow. */
+	if (cap <= vec->cap)
+		return 0;
+
+	/* Grow to exactly passed capacity. */
+	ret = vec_realloc(vec, cap);
+	return ret;
 }
 
 int
@@ -254,6 +290,25 @@ err_undo:
 	return -1;
 }
 
+int
+vec_rm_range(struct vec *const vec, const size_t idx, const size_t cnt)
+{
+	/* Validate range. */
+	if (idx > vec->len || cnt > vec->len - idx) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* Move items left to overlap removed ones. */
+	memmove(
+		&vec->items[idx * vec->item_size],
+		&vec->items[(idx + cnt) * vec->item_size],
+		(vec->len - idx - cnt) * vec->item_size
+	);
+	vec->len -= cnt;
+	return 0;
+}
+
 int
 vec_set_len(struct vec *const vec, const size_t len)
 {
@@ -283,7 +338,10 @@ vec_shrink_if_needed(struct vec *const vec)
 	/* Check there is not enough unused space to shrink. */
 	if (vec->len + vec->cap_step > vec->cap)
 		return 0;
+	if (vec->len > vec->cap / VEC_SHRINK_RATIO)
+		return 0;
 
-	ret = vec_realloc(vec, vec->len);
+	/* Leave space to grow without reallocation back. */
+	ret = vec_realloc(vec, vec->len * 2);
 	return ret;
 }
@@ -7,7 +7,8 @@
 struct vec;
 
 /*
- * Allocates new vector. Do not forget to free it.
+ * Allocates new vector with passed item size and min capacity step. Capacity
+ * grows geometrically starting from the step. Do not forget to free it.
  *
  * Returns pointer to opaque vector on success and `NULL` on error.
  */
@@ -81,7 +82,16 @@ int vec_ins_fmt(struct vec *, size_t, const char *, ...);
 size_t vec_len(const struct vec *);
 
 /*
- * Finds and removes item by its index. Shrinks capacity if too much space is
+ * Grows capacity to store passed count of items without reallocations. Does
+ * nothing if capacity is already enough. Useful if count of items is known
+ * beforehand.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int vec_reserve(struct vec *, size_t);
+
+/*
+ * Finds and removes item by its index. Shrinks capacity if most of it is
  * unused.
  *
  * If a pointer for the removed item is passed, then after the error the state
@@ -94,6 +104,16 @@ size_t vec_len(const struct vec *);
  */
 int vec_rm(struct vec *, size_t, void *);
 
+/*
+ * Removes passed count of items beginning with passed index. Leaves the
+ * capacity unchanged, so shrink the capacity if needed.
+ *
+ * Returns 0 on success and -1 on error.
+ *
+ * Sets `EINVAL` if range is invalid.
+ */
+int vec_rm_range(struct vec *, size_t, size_t);
+
 /*
  * Sets length and leaves the capacity unchanged, so shrink the capacity if
  * needed.
@@ -105,7 +125,8 @@ int vec_rm(struct vec *, size_t, void *);
 int vec_set_len(struct vec *, size_t);
 
 /*
- * Shrinks capacity if too much space is unused.
+ * Shrinks capacity if most of it is unused. Leaves space to grow, so the
+ * following insertions do not reallocate.
  *
  * Returns 0 on success and -1 on error.
  */
@@ -6,7 +6,6 @@
 #include "esc.h"
 #include "file.h"
 #include "math.h"
-#include "str.h"
 #include "term.h"
 #include "vec.h"
 #include "win.h"
@@ -32,6 +31,16 @@ struct offset {
 	size_t cols;
 };
 
+/*
+ * Content of rows which is drawn on the terminal now. Used to draw only
+ * changed rows.
+ */
+struct drawn {
+	char *rows; /* Characters of rows. Every row has window width capacity. */
+	unsigned short *lens; /* Lengths of drawn rows. */
+	size_t offset_rows; /* Rows offset of drawn content. */
+};
+
 /*
  * Window parameters.
  *
@@ -42,21 +51,65 @@ struct win {
 	struct offset offset; /* offset of view/file. Tab's width is 1. */
 	struct cur cur; /* Pointer to the viewed char. Tab's width is 1. */
 	struct winsize size; /* Terminal window size. */
+	struct drawn drawn; /* Drawn content of rows with lines. */
 };
 
 /*
- * Draws row on the window if exists or special config string.
+ * Reallocates drawn content for current window size. Drawn content is
+ * invalid after it, so clear the window.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int win_alloc_drawn(struct win *);
+
+/*
+ * Draws row on the window if it differs from drawn one. Drawn content is
+ * appended to slices.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int win_draw_line(
+	struct win *, struct vec *, struct vec *, unsigned short);
+
+/*
+ * Scrolls drawn rows if rows offset is changed. So rows which are still
+ * visible are not drawn again.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+static int win_draw_scroll(struct win *, struct vec *);
+
+/*
+ * Moves cursor to passed position on the current line. Offset is kept if the
+ * position is visible. Otherwise, the window is shifted to its nearest edge.
+ */
+static void win_mv_to_char(struct win *, size_t);
+
+/*
+ * Moves cursor to the line by passed index. Offset is kept if the line is
+ * visible. Otherwise, the window is shifted to its nearest edge.
+ */
+static void win_mv_to_line(struct win *, size_t);
+
+/*
+ * Moves to passed line and position. Line index is clamped to the last line.
  *
  * Returns 0 on success and -1 on error.
  */
-static int win_draw_line(const struct win *, struct vec *, unsigned short);
+static int win_mv_to_pos(struct win *, size_t, size_t);
 
 /*
- * Gets the count of characters by which the part of line is expanded using
- * tabs. The part of the line from the beginning to the passed column is
- * considered.
+ * Gets content of the row. It is the visible part of the line or special
+ * config string if there is no line.
+ *
+ * Returns 0 on success and -1 on error.
  */
-static size_t win_exp_col(const struct pub_line *, size_t);
+static int win_row(const struct win *, unsigned short, const char **, size_t *);
+
+/*
+ * Returns count of rows with lines.
+ */
+static unsigned short win_rows_cnt(const struct win *);
 
 /*
  * Collection of methods to scroll and fix cursor.
@@ -82,6 +135,27 @@ static void win_scroll_overflowed_cur(struct win *);
  */
 static int win_scroll_to_line(struct win *);
 
+static int
+win_alloc_drawn(struct win *const win)
+{
+	char *rows;
+	unsigned short *lens;
+	const size_t rows_cnt = win_rows_cnt(win);
+
+	/* Reallocate rows with new window size. */
+	rows = realloc(win->drawn.rows, MAX(rows_cnt * win->size.ws_col, 1));
+	if (NULL == rows)
+		return -1;
+	win->drawn.rows = rows;
+
+	/* Reallocate lengths with new rows count. */
+	lens = realloc(win->drawn.lens, MAX(rows_cnt, 1) * sizeof(*lens));
+	if (NULL == lens)
+		return -1;
+	win->drawn.lens = lens;
+	return 0;
+}
+
 int
 win_close(struct win *const win)
 {
@@ -94,6 +168,9 @@ win_close(struct win *const win)
 
 	/* Close opened file. */
 	file_close(win->file);
+	/* Free drawn content. */
+	free(win->drawn.rows);
+	free(win->drawn.lens);
 	/* Free opaque struct. */
 	free(win);
 	return 0;
@@ -111,6 +188,13 @@ win_curr_line_char_idx(const struct win *const win)
 	return win->offset.cols + win->cur.col;
 }
 
+size_t
+win_curr_offset(const struct win *const win)
+{
+	return file_offset_of(
+		win->file, win_curr_line_idx(win), win_curr_line_char_idx(win));
+}
+
 int
 win_break_line(struct win *const win)
 {
@@ -204,79 +288,115 @@ int
 win_draw_cur(const struct win *const win, struct vec *const buf)
 {
 	int ret;
-	struct pub_line line;
 	size_t exp_offset_col;
 	size_t exp_col;
+	const size_t idx = win_curr_line_idx(win);
 
-	/* Get line. */
-	ret = file_line(win->file, win_curr_line_idx(win), &line);
+	/* Expand offset and file columns. */
+	ret = file_line_exp_col(win->file, idx, win->offset.cols, &exp_offset_col);
+	if (-1 == ret)
+		return -1;
+	ret = file_line_exp_col(
+		win->file, idx, win_curr_line_char_idx(win), &exp_col);
 	if (-1 == ret)
 		return -1;
-
-	/* Expand offset and file columns. */
-	exp_offset_col = win_exp_col(&line, win->offset.cols);
-	exp_col = win_exp_col(&line, win->offset.cols + win->cur.col);
 
 	/* Sub expanded columns to get real column in the window and set cursor. */
 	esc_cur_set(buf, win->cur.row, exp_col - exp_offset_col);
 	return 0;
 }
 
-static int
-win_draw_line(
-	const struct win *const win, struct vec *const buf, const unsigned short row)
+int
+win_draw_clr(struct win *const win, struct vec *const buf)
 {
 	int ret;
-	struct pub_line line;
-	size_t exp_offset_col;
-	size_t len_to_draw;
-	size_t lines_cnt;
+	const unsigned short rows_cnt = win_rows_cnt(win);
 
-	/* Get lines count. */
-	lines_cnt = file_lines_cnt(win->file);
+	/* Clear all window. */
+	ret = esc_clr_win(buf);
+	if (-1 == ret)
+		return -1;
 
-	/* Checking if there is a line to draw at this row. */
-	if (win->offset.rows + row >= lines_cnt) {
-		ret = vec_append(buf, &cfg_no_line, 1);
-		return ret;
+	/* Scroll only rows with lines, so status stays in place. */
+	if (rows_cnt > 0) {
+		ret = esc_scroll_region_set(buf, 0, rows_cnt - 1);
+		if (-1 == ret)
+			return -1;
 	}
 
-	/* Get line. */
-	ret = file_line(win->file, win->offset.rows + row, &line);
+	/* Window is empty now. */
+	memset(win->drawn.lens, 0, rows_cnt * sizeof(*win->drawn.lens));
+	win->drawn.offset_rows = win->offset.rows;
+	return 0;
+}
+
+static int
+win_draw_line(
+	struct win *const win,
+	struct vec *const buf,
+	struct vec *const slices,
+	const unsigned short row)
+{
+	int ret;
+	const char *chars;
+	size_t len;
+	struct term_slice slice;
+	char *const drawn = &win->drawn.rows[row * win->size.ws_col];
+	const size_t drawn_len = win->drawn.lens[row];
+
+	/* Get content of the row. */
+	ret = win_row(win, row, &chars, &len);
 	if (-1 == ret)
 		return -1;
 
-	/* Get expanded with tabs offset's column. */
-	exp_offset_col = win_exp_col(&line, win->offset.cols);
-	/* Do nothing if line hidden behind offset or empty. */
-	if (line.render_len <= exp_offset_col)
+	/* Do nothing if the same content is already drawn. */
+	if (len == drawn_len && 0 == memcmp(chars, drawn, len))
 		return 0;
 
-	/* Calculate length to draw using expanded length and draw. */
-	len_to_draw = MIN(win->size.ws_col, line.render_len - exp_offset_col);
-	ret = vec_append(buf, &line.render[exp_offset_col], len_to_draw);
-	return ret;
+	/* Remember drawn content. It is written from there without copying. */
+	memcpy(drawn, chars, len);
+	win->drawn.lens[row] = len;
+
+	/* Move to the beginning of the row and draw the content. */
+	ret = esc_cur_set(buf, row, 0);
+	if (-1 == ret)
+		return -1;
+	slice.at = vec_len(buf);
+	slice.chars = drawn;
+	slice.len = len;
+	ret = vec_append(slices, &slice, 1);
+	if (-1 == ret)
+		return -1;
+
+	/* Clear the rest of previously drawn content. */
+	if (len < drawn_len) {
+		ret = esc_clr_line_end(buf);
+		if (-1 == ret)
+			return -1;
+	}
+	return 0;
 }
 
 int
-win_draw_lines(const struct win *const win, struct vec *const buf)
+win_draw_lines(
+	struct win *const win, struct vec *const buf, struct vec *const slices)
 {
 	int ret;
 	unsigned short row;
 
+	/* Scroll already drawn rows if possible. */
+	ret = win_draw_scroll(win, buf);
+	if (-1 == ret)
+		return -1;
+
 	/* Set colors. */
 	ret = esc_color_fg(buf, cfg_color_lines_fg);
 	if (-1 == ret)
 		return -1;
 
-	for (row = 0; row + STAT_ROWS_CNT < win->size.ws_row; row++) {
-		/* Draw line. */
-		ret = win_draw_line(win, buf, row);
-		if (-1 == ret)
-			return -1;
-
-		/* Move to the beginning of the next row. */
-		ret = vec_append(buf, "\r\n", 2);
+	for (row = 0; row < win_rows_cnt(win); row++) {
+		/* Draw line if changed. */
+		ret = win_draw_line(win, buf, slices, row);
 		if (-1 == ret)
 			return -1;
 	}
@@ -286,17 +406,62 @@ win_draw_lines(const struct win *const win, struct vec *const buf)
 	return ret;
 }
 
-static size_t
-win_exp_col(const struct pub_line *const line, const size_t col)
+static int
+win_draw_scroll(struct win *const win, struct vec *const buf)
 {
-	size_t i;
-	size_t exp = 0;
-	const size_t end = MIN(col, line->len);
+	int ret;
+	size_t shift;
+	const unsigned short rows_cnt = win_rows_cnt(win);
+	const size_t row_size = win->size.ws_col;
+	struct drawn *const drawn = &win->drawn;
+
+	if (win->offset.rows > drawn->offset_rows) {
+		/* Scroll up if there are still visible rows. */
+		shift = win->offset.rows - drawn->offset_rows;
+		if (shift < rows_cnt) {
+			ret = esc_scroll_up(buf, shift);
+			if (-1 == ret)
+				return -1;
+
+			/* Move drawn rows up and forget empty rows at the bottom. */
+			memmove(
+				drawn->rows,
+				&drawn->rows[shift * row_size],
+				(rows_cnt - shift) * row_size
+			);
+			memmove(
+				drawn->lens,
+				&drawn->lens[shift],
+				(rows_cnt - shift) * sizeof(*drawn->lens)
+			);
+			memset(
+				&drawn->lens[rows_cnt - shift], 0, shift * sizeof(*drawn->lens));
+		}
+	} else if (win->offset.rows < drawn->offset_rows) {
+		/* Scroll down if there are still visible rows. */
+		shift = drawn->offset_rows - win->offset.rows;
+		if (shift < rows_cnt) {
+			ret = esc_scroll_down(buf, shift);
+			if (-1 == ret)
+				return -1;
 
-	/* Iterate over every character in the selected area. */
-	for (i = 0; i < end; i++)
-		exp += str_exp(line->chars[i], exp);
-	return exp;
+			/* Move drawn rows down and forget empty rows at the top. */
+			memmove(
+				&drawn->rows[shift * row_size],
+				drawn->rows,
+				(rows_cnt - shift) * row_size
+			);
+			memmove(
+				&drawn->lens[shift],
+				drawn->lens,
+				(rows_cnt - shift) * sizeof(*drawn->lens)
+			);
+			memset(drawn->lens, 0, shift * sizeof(*drawn->lens));
+		}
+	}
+
+	drawn->offset_rows = win->offset.rows;
+	return 0;
 }
 
 char
@@ -305,12 +470,30 @@ win_file_is_dirty(const struct win *const win)
 	return file_is_dirty(win->file);
 }
 
+char
+win_file_is_saving(const struct win *const win)
+{
+	return file_is_saving(win->file);
+}
+
+char
+win_file_is_undo_synced(const struct win *const win)
+{
+	return file_is_undo_synced(win->file);
+}
+
 const char*
 win_file_path(const struct win *const win)
 {
 	return file_path(win->file);
 }
 
+void
+win_file_sync_undo(struct win *const win)
+{
+	file_sync_undo(win->file);
+}
+
 int
 win_ins_char(struct win *const win, const char ch)
 {
@@ -380,25 +563,64 @@ win_ins_empty_line_on_top(struct win *const win, size_t times)
 	return 0;
 }
 
+int
+win_ins_text(struct win *const win, const char *const text, const size_t len)
+{
+	int ret;
+	struct pub_line line;
+	size_t tail_len;
+	size_t brks_cnt;
+	const size_t lines_cnt = file_lines_cnt(win->file);
+
+	/* Remember length of line's part which will be after inserted text. */
+	ret = file_line(win->file, win_curr_line_idx(win), &line);
+	if (-1 == ret)
+		return -1;
+	tail_len = line.len - win_curr_line_char_idx(win);
+
+	/* Insert text. */
+	ret = file_ins_text(
+		win->file,
+		win_curr_line_idx(win),
+		win_curr_line_char_idx(win),
+		text,
+		len
+	);
+	if (-1 == ret)
+		return -1;
+
+	/* Move right after insertion without line breaks. */
+	brks_cnt = file_lines_cnt(win->file) - lines_cnt;
+	if (0 == brks_cnt) {
+		ret = win_mv_right(win, len);
+		return ret;
+	}
+
+	/* Move to the last inserted line. */
+	win_mv_to_begin_of_line(win);
+	ret = win_mv_down(win, brks_cnt);
+	if (-1 == ret)
+		return -1;
+
+	/* Move to the end of inserted text on the last line. */
+	ret = file_line(win->file, win_curr_line_idx(win), &line);
+	if (-1 == ret)
+		return -1;
+	ret = win_mv_right(win, line.len - tail_len);
+	return ret;
+}
+
 int
 win_mv_down(struct win *const win, size_t times)
 {
 	int ret;
+	const size_t idx = win_curr_line_idx(win);
 
+	/* Return if there is no more space to move down. */
+	times = MIN(times, file_lines_cnt(win->file) - 1 - idx);
 	if (0 == times)
 		return 0;
-
-	while (times-- > 0) {
-		/* Return if there is no more space to move down. */
-		if (win->offset.rows + win->cur.row + 1 >= file_lines_cnt(win->file))
-			return 0;
-
-		/* Check that there is no space in current window. */
-		if (win->cur.row + STAT_ROWS_CNT + 1 == win->size.ws_row)
-			win->offset.rows++;
-		else
-			win->cur.row++;
-	}
+	win_mv_to_line(win, idx + times);
 
 	/* Clamp cursor to line after move down several times. */
 	ret = win_scroll(win);
@@ -409,29 +631,33 @@ int
 win_mv_left(struct win *const win, size_t times)
 {
 	int ret;
+	size_t off;
+	size_t idx;
+	size_t pos;
+	struct pub_line line;
 
 	if (0 == times)
 		return 0;
 
-	while (times-- > 0) {
-		if (win->offset.cols + win->cur.col == 0) {
-			/* Check there is no next line. */
-			if (win->offset.rows + win->cur.row == 0)
-				break;
+	/* Stay on the current line if its beginning is not crossed. */
+	pos = win_curr_line_char_idx(win);
+	if (times <= pos) {
+		pos -= times;
+	} else {
+		/* Find the target by byte offset, so lines are not visited. */
+		off = file_offset_of(win->file, win_curr_line_idx(win), 0);
+		off -= MIN(times - pos, off);
+		file_pos_of_offset(win->file, off, &idx, &pos);
 
-			/* Move to the beginning of next line if no space to move left. */
-			ret = win_mv_up(win, 1);
-			if (-1 == ret)
-				return -1;
-			win_mv_to_end_of_line(win);
-		} else if (win->cur.col == 0) {
-			/* We are at the right of window, but have non-zero offset. */
-			win->offset.cols--;
-		} else {
-			/* We are have enough space to move right in the current window. */
-			win->cur.col--;
-		}
+		/* Previous line is entered from its end. Only its length is needed. */
+		ret = file_line_head(win->file, idx, 0, &line);
+		if (-1 == ret)
+			return -1;
+		win_mv_to_line(win, idx);
+		win_mv_to_begin_of_line(win);
+		win_mv_to_char(win, line.len);
 	}
+	win_mv_to_char(win, pos);
 
 	/* Fix expanded cursor column during left movement. */
 	ret = win_scroll(win);
@@ -442,40 +668,24 @@ int
 win_mv_right(struct win *const win, size_t times)
 {
 	int ret;
-	struct pub_line line;
+	size_t off;
+	size_t idx;
+	size_t pos;
 
 	if (0 == times)
 		return 0;
 
-	/* Get line. */
-	ret = file_line(win->file, win_curr_line_idx(win), &line);
-	if (-1 == ret)
-		return -1;
-
-	while (times-- > 0) {
-		if (win_curr_line_char_idx(win) >= line.len) {
-			/* Check there is no next line. */
-			if (win_curr_line_idx(win) + 1 == file_lines_cnt(win->file))
-				break;
-
-			/* Move to the beginning of next line because of end of line. */
-			win_mv_to_begin_of_line(win);
-			ret = win_mv_down(win, 1);
-			if (-1 == ret)
-				return -1;
+	/* Find the target by byte offset, so crossed lines are not visited. */
+	off = file_offset_of(
+		win->file, win_curr_line_idx(win), win_curr_line_char_idx(win));
+	file_pos_of_offset(win->file, off + MIN(times, SIZE_MAX - off), &idx, &pos);
 
-			/* Update line data because of moving to new line. */
-			ret = file_line(win->file, win_curr_line_idx(win), &line);
-			if (-1 == ret)
-				return -1;
-		} else if (win->cur.col + 1 >= win->size.ws_col) {
-			/* We are at the right of window but can shift offset. */
-			win->offset.cols++;
-		} else {
-			/* We are have enough space to move right in the current window. */
-			win->cur.col++;
-		}
+	/* Next line is entered from its beginning. */
+	if (idx != win_curr_line_idx(win)) {
+		win_mv_to_line(win, idx);
+		win_mv_to_begin_of_line(win);
 	}
+	win_mv_to_char(win, pos);
 
 	/* Fix expanded cursor column during right movement. */
 	ret = win_scroll(win);
@@ -532,10 +742,10 @@ win_mv_to_end_of_line(struct win *const win)
 		return -1;
 
 	/* Check that end of line in the current window. */
-	if (line.render_len < win->offset.cols + win->size.ws_col) {
-		win->cur.col = line.render_len - win->offset.cols;
+	if (line.len < win->offset.cols + win->size.ws_col) {
+		win->cur.col = line.len - win->offset.cols;
 	} else {
-		win->offset.cols = line.render_len - win->size.ws_col + 1;
+		win->offset.cols = line.len - win->size.ws_col + 1;
 		win->cur.col = win->size.ws_col - 1;
 	}
 
@@ -580,6 +790,21 @@ win_mv_to_next_word(struct win *const win, size_t times)
 	return ret;
 }
 
+int
+win_mv_to_offset(struct win *const win, const size_t off)
+{
+	int ret;
+	size_t idx;
+	size_t pos;
+
+	/* Find line and position by the offset. */
+	file_pos_of_offset(win->file, off, &idx, &pos);
+
+	/* Move to found line and position. */
+	ret = win_mv_to_pos(win, idx, pos);
+	return ret;
+}
+
 int
 win_mv_to_prev_word(struct win *const win, size_t times)
 {
@@ -621,27 +846,79 @@ int
 win_mv_up(struct win *const win, size_t times)
 {
 	int ret;
+	const size_t idx = win_curr_line_idx(win);
 
 	if (0 == times)
 		return 0;
 
-	while (times-- > 0) {
-		/* Break if there is no more space to move up. */
-		if (win->offset.rows + win->cur.row == 0)
-			break;
-
-		/* Check that there is no space in current window. */
-		if (0 == win->cur.row)
-			win->offset.rows--;
-		else
-			win->cur.row--;
-	}
+	/* Stop at the first line if there is no more space to move up. */
+	win_mv_to_line(win, idx - MIN(times, idx));
 
 	/* Clamp cursor to line after move down several times. */
 	ret = win_scroll(win);
 	return ret;
 }
 
+static void
+win_mv_to_char(struct win *const win, const size_t pos)
+{
+	if (pos < win->offset.cols) {
+		/* Position is at the left of window. */
+		win->offset.cols = pos;
+		win->cur.col = 0;
+	} else if (pos - win->offset.cols < win->size.ws_col) {
+		/* Position is in the current window. */
+		win->cur.col = pos - win->offset.cols;
+	} else {
+		/* Position is at the right of window. */
+		win->offset.cols = pos - win->size.ws_col + 1;
+		win->cur.col = win->size.ws_col - 1;
+	}
+}
+
+static void
+win_mv_to_line(struct win *const win, const size_t idx)
+{
+	const unsigned short rows_cnt = win_rows_cnt(win);
+
+	if (idx < win->offset.rows) {
+		/* Line is above the window. */
+		win->offset.rows = idx;
+		win->cur.row = 0;
+	} else if (idx - win->offset.rows < rows_cnt) {
+		/* Line is in the current window. */
+		win->cur.row = idx - win->offset.rows;
+	} else {
+		/* Line is below the window. */
+		win->offset.rows = idx - rows_cnt + 1;
+		win->cur.row = rows_cnt - 1;
+	}
+}
+
+static int
+win_mv_to_pos(struct win *const win, size_t idx, const size_t pos)
+{
+	int ret;
+
+	/* Line may be deleted by the change. */
+	idx = MIN(idx, file_lines_cnt(win->file) - 1);
+
+	/* Move to begin of line to easily move right to position later. */
+	win_mv_to_begin_of_line(win);
+
+	/* Move to the line. */
+	if (idx < win_curr_line_idx(win))
+		ret = win_mv_up(win, win_curr_line_idx(win) - idx);
+	else
+		ret = win_mv_down(win, idx - win_curr_line_idx(win));
+	if (-1 == ret)
+		return -1;
+
+	/* Move to the position on the line. */
+	ret = win_mv_right(win, pos);
+	return ret;
+}
+
 struct win*
 win_open(const char *const path, const int ifd, const int ofd)
 {
@@ -658,9 +935,10 @@ win_open(const char *const path, const int ifd, const int ofd)
 	if (NULL == win->file)
 		goto err_free_opaque;
 
-	/* Initialize offset and cursor. */
+	/* Initialize offset, cursor and drawn content. */
 	memset(&win->offset, 0, sizeof(win->offset));
 	memset(&win->cur, 0, sizeof(win->cur));
+	memset(&win->drawn, 0, sizeof(win->drawn));
 
 	/* Initialize terminal with accepted descriptors. */
 	ret = term_init(ifd, ofd);
@@ -669,12 +947,19 @@ win_open(const char *const path, const int ifd, const int ofd)
 
 	/* Get window size. */
 	ret = term_get_win_size(&win->size);
+	if (-1 == ret)
+		goto err_clean_all;
+
+	/* Allocate drawn content for the window size. */
+	ret = win_alloc_drawn(win);
 	if (-1 == ret)
 		goto err_clean_all;
 	return win;
 err_clean_all:
 	/* Errors checking here is useless. */
 	term_deinit();
+	free(win->drawn.rows);
+	free(win->drawn.lens);
 err_free_opaque_and_close:
 	file_close(win->file);
 err_free_opaque:
@@ -682,13 +967,97 @@ err_free_opaque:
 	return NULL;
 }
 
-size_t
-win_save_file(struct win *const win)
+static int
+win_row(
+	const struct win *const win,
+	const unsigned short row,
+	const char **const chars,
+	size_t *const len)
 {
-	size_t len;
+	int ret;
+	struct pub_line line;
+	size_t exp_offset_col;
+	const size_t idx = win->offset.rows + row;
+
+	/* Checking if there is a line to draw at this row. */
+	if (idx >= file_lines_cnt(win->file)) {
+		*chars = &cfg_no_line;
+		*len = 1;
+		return 0;
+	}
+
+	/* Get expanded with tabs offset's column. */
+	ret = file_line_exp_col(win->file, idx, win->offset.cols, &exp_offset_col);
+	if (-1 == ret)
+		return -1;
+
+	/* Get rendered line's head up to the right edge of the window. */
+	ret = file_line_render(
+		win->file, idx, win->offset.cols + win->size.ws_col, &line);
+	if (-1 == ret)
+		return -1;
+
+	/* Row is empty if line hidden behind offset or empty. */
+	if (line.render_len <= exp_offset_col) {
+		*chars = NULL;
+		*len = 0;
+		return 0;
+	}
+
+	/* Calculate length to draw using expanded length. */
+	*chars = &line.render[exp_offset_col];
+	*len = MIN(win->size.ws_col, line.render_len - exp_offset_col);
+	return 0;
+}
+
+static unsigned short
+win_rows_cnt(const struct win *const win)
+{
+	return win->size.ws_row > STAT_ROWS_CNT ? win->size.ws_row - STAT_ROWS_CNT : 0;
+}
+
+int
+win_redo(struct win *const win, size_t times)
+{
+	int ret;
+	size_t idx;
+	size_t pos;
+	char is_redone = 0;
+
+	/* Apply changes again until there is nothing to redo. */
+	while (times-- > 0) {
+		ret = file_redo(win->file, &idx, &pos);
+		if (-1 == ret)
+			return -1;
+		if (0 == ret)
+			break;
+		is_redone = 1;
+	}
+
+	/* Move to the last applied change. */
+	if (!is_redone)
+		return 0;
+	ret = win_mv_to_pos(win, idx, pos);
+	return ret;
+}
+
+int
+win_save_file_bg(struct win *const win)
+{
+	int ret;
 
-	len = file_save(win->file, NULL);
-	return len;
+	ret = file_save_bg(win->file);
+	return ret;
+}
+
+int
+win_save_file_bg_poll(
+	struct win *const win, size_t *const written, size_t *const len)
+{
+	int ret;
+
+	ret = file_save_bg_poll(win->file, written, len);
+	return ret;
 }
 
 size_t
@@ -719,27 +1088,30 @@ static int
 win_scroll_exp_col(struct win *const win)
 {
 	int ret;
-	struct pub_line line;
-	size_t exp_offset_col;
 	size_t exp_col;
+	size_t col;
+	const size_t idx = win_curr_line_idx(win);
 
-	/* Get current line. */
-	ret = file_line(win->file, win_curr_line_idx(win), &line);
+	/* Get expanded column of the cursor. */
+	ret = file_line_exp_col(
+		win->file, idx, win_curr_line_char_idx(win), &exp_col);
 	if (-1 == ret)
 		return -1;
 
-	while (1) {
-		/* Get expanded hidden column and expanded viewed column. */
-		exp_col = win_exp_col(&line, win->offset.cols + win->cur.col);
-		exp_offset_col = win_exp_col(&line, win->offset.cols);
+	/* Cursor is visible with any offset if it is close to the beginning. */
+	if (exp_col < win->size.ws_col)
+		return 0;
 
-		/* Check that diff between expansion is not greater than window's width. */
-		if (exp_col - exp_offset_col < win->size.ws_col)
-			break;
+	/* Find the first column which keeps the cursor in the window. */
+	ret = file_line_col_by_exp(
+		win->file, idx, exp_col - win->size.ws_col + 1, &col);
+	if (-1 == ret)
+		return -1;
 
-		/* Shift to view pointed content. */
-		win->offset.cols++;
-		win->cur.col--;
+	/* Shift to view pointed content. */
+	if (col > win->offset.cols) {
+		win->cur.col -= col - win->offset.cols;
+		win->offset.cols = col;
 	}
 	return 0;
 }
@@ -763,8 +1135,8 @@ win_scroll_to_line(struct win *const win)
 	int ret;
 	struct pub_line line;
 
-	/* Get current line. */
-	ret = file_line(win->file, win_curr_line_idx(win), &line);
+	/* Get current line. Only its length is needed. */
+	ret = file_line_head(win->file, win_curr_line_idx(win), 0, &line);
 	if (-1 == ret)
 		return -1;
 
@@ -858,6 +1230,31 @@ win_size(const struct win *const win)
 	return win->size;
 }
 
+int
+win_undo(struct win *const win, size_t times)
+{
+	int ret;
+	size_t idx;
+	size_t pos;
+	char is_undone = 0;
+
+	/* Revert changes until there is nothing to undo. */
+	while (times-- > 0) {
+		ret = file_undo(win->file, &idx, &pos);
+		if (-1 == ret)
+			return -1;
+		if (0 == ret)
+			break;
+		is_undone = 1;
+	}
+
+	/* Move to the last reverted change. */
+	if (!is_undone)
+		return 0;
+	ret = win_mv_to_pos(win, idx, pos);
+	return ret;
+}
+
 int
 win_upd_size(struct win *const win)
 {
@@ -868,6 +1265,11 @@ win_upd_size(struct win *const win)
 	if (-1 == ret)
 		return -1;
 
+	/* Drawn content does not fit new size. */
+	ret = win_alloc_drawn(win);
+	if (-1 == ret)
+		return -1;
+
 	/* Scroll after resize. */
 	ret = win_scroll(win);
 	return ret;
@@ -27,6 +27,11 @@ size_t win_curr_line_idx(const struct win *);
  */
 size_t win_curr_line_char_idx(const struct win *);
 
+/*
+ * Gets cursor's byte offset in the saved file.
+ */
+size_t win_curr_offset(const struct win *);
+
 /*
  * Breaks current line at cursor position.
  */
@@ -47,26 +52,54 @@ int win_del_char(struct win *);
  */
 int win_del_line(struct win *, size_t);
 
+/*
+ * Clears the window and forgets drawn content. Use it if content on the
+ * terminal is unknown, for example, after resizing.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int win_draw_clr(struct win *, struct vec *);
+
 /*
  * Draws cursor.
  */
 int win_draw_cur(const struct win *, struct vec *);
 
 /*
- * Draws window rows.
+ * Draws window rows which differ from drawn ones. Scrolls drawn rows if
+ * possible. Content of rows is not copied to the buffer, but appended to the
+ * passed vector of `struct term_slice`. Slices are valid until the next
+ * drawing or resizing.
+ *
+ * Returns 0 on success and -1 on error.
  */
-int win_draw_lines(const struct win *, struct vec *);
+int win_draw_lines(struct win *, struct vec *, struct vec *);
 
 /*
  * Checks that opened file is dirty.
  */
 char win_file_is_dirty(const struct win *);
 
+/*
+ * Checks that opened file is being saved in background.
+ */
+char win_file_is_saving(const struct win *);
+
+/*
+ * Checks that all changes of opened file are synced to its journal file.
+ */
+char win_file_is_undo_synced(const struct win *);
+
 /*
  * Returns opened file's path.
  */
 const char *win_file_path(const struct win *);
 
+/*
+ * Syncs changes of opened file to its journal file.
+ */
+void win_file_sync_undo(struct win *);
+
 /*
  * Inserts character to the file.
  */
@@ -82,6 +115,12 @@ int win_ins_empty_line_below(struct win *, size_t);
  */
 int win_ins_empty_line_on_top(struct win *, size_t);
 
+/*
+ * Inserts text to the file and moves the cursor to the end of inserted text.
+ * Text may contain line breaks.
+ */
+int win_ins_text(struct win *, const char *, size_t);
+
 /*
  * Move down several times.
  */
@@ -122,6 +161,14 @@ int win_mv_to_end_of_line(struct win *);
  */
 int win_mv_to_next_word(struct win *, size_t);
 
+/*
+ * Moves to passed byte offset in the saved file. Offset is clamped to the end
+ * of file.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int win_mv_to_offset(struct win *, size_t);
+
 /*
  * Moves to previous word.
  */
@@ -138,9 +185,28 @@ int win_mv_up(struct win *, size_t);
 struct win *win_open(const char *, int, int);
 
 /*
- * Saves opened file. Returns saved bytes count.
+ * Applies undone changes again several times and moves to the last one.
+ *
+ * Returns 0 on success and -1 on error.
  */
-size_t win_save_file(struct win *);
+int win_redo(struct win *, size_t);
+
+/*
+ * Starts saving of opened file in background.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int win_save_file_bg(struct win *);
+
+/*
+ * Checks saving of opened file in background. Writes saved bytes count and
+ * total bytes count to passed pointers. The total is size of the saved file
+ * after finishing.
+ *
+ * Returns 1 if the saving is finished, 0 if it is in progress and -1 if it is
+ * failed.
+ */
+int win_save_file_bg_poll(struct win *, size_t *, size_t *);
 
 /*
  * Saves opened file to spare directory. Returns saved bytes count. Writes path
@@ -167,6 +233,13 @@ int win_search_fwd(struct win *, const char *);
  */
 struct winsize win_size(const struct win *);
 
+/*
+ * Reverts changes several times and moves to the last reverted one.
+ *
+ * Returns 0 on success and -1 on error.
+ */
+int win_undo(struct win *, size_t);
+
 /*
  * Updates size of opened window using terminal.
  */